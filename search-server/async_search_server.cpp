@@ -0,0 +1,162 @@
+#include "async_search_server.h"
+#include <algorithm>
+
+namespace {
+
+const char* GetReasonMessage(QueryDroppedError::Reason reason) {
+    switch (reason) {
+    case QueryDroppedError::Reason::QUEUE_FULL:
+        return "Query queue is full";
+    case QueryDroppedError::Reason::DEADLINE_EXCEEDED:
+        return "Query deadline exceeded";
+    case QueryDroppedError::Reason::CANCELLED:
+        return "Query cancelled";
+    case QueryDroppedError::Reason::SHUTDOWN:
+        return "Search server is shutting down";
+    }
+    return "Query dropped";
+}
+
+}
+
+QueryDroppedError::QueryDroppedError(Reason reason)
+    : std::runtime_error(GetReasonMessage(reason))
+    , reason_(reason)
+{
+}
+
+QueryDroppedError::Reason QueryDroppedError::GetReason() const {
+    return reason_;
+}
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server, const Options& options)
+    : search_server_(search_server)
+    , options_(options)
+{
+    const size_t worker_count = std::max<size_t>(1, options_.worker_count);
+    workers_.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers_.emplace_back([this] { RunWorker(); });
+    }
+}
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server)
+    : AsyncSearchServer(search_server, Options{})
+{
+}
+
+AsyncSearchServer::~AsyncSearchServer() {
+    {
+        std::lock_guard queue_lock(queue_mutex_);
+        is_stopped_ = true;
+    }
+    queue_not_empty_.notify_all();
+    queue_not_full_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+AsyncSearchServer::QueryTicket AsyncSearchServer::Submit(std::string raw_query, DocumentStatus status,
+    Clock::time_point deadline) {
+
+    Request request;
+    request.raw_query = std::move(raw_query);
+    request.status = status;
+    request.deadline = deadline;
+    request.is_cancelled = std::make_shared<std::atomic<bool>>(false);
+
+    QueryTicket ticket{ request.result.get_future(), request.is_cancelled };
+
+    std::unique_lock queue_lock(queue_mutex_);
+    const size_t capacity = std::max<size_t>(1, options_.queue_capacity);
+    if (queue_.size() >= capacity && !is_stopped_) {
+        const auto has_free_slot = [this, capacity] { return is_stopped_ || queue_.size() < capacity; };
+        if (options_.overload_policy == OverloadPolicy::REJECT) {
+            queue_lock.unlock();
+            ++rejected_count_;
+            Drop(request, QueryDroppedError::Reason::QUEUE_FULL);
+            return ticket;
+        }
+        if (deadline == Clock::time_point::max()) {
+            queue_not_full_.wait(queue_lock, has_free_slot);
+        }
+        else if (!queue_not_full_.wait_until(queue_lock, deadline, has_free_slot)) {
+            queue_lock.unlock();
+            ++expired_count_;
+            Drop(request, QueryDroppedError::Reason::DEADLINE_EXCEEDED);
+            return ticket;
+        }
+    }
+    if (is_stopped_) {
+        queue_lock.unlock();
+        Drop(request, QueryDroppedError::Reason::SHUTDOWN);
+        return ticket;
+    }
+    queue_.push_back(std::move(request));
+    queue_lock.unlock();
+    queue_not_empty_.notify_one();
+
+    return ticket;
+}
+
+AsyncSearchServer::Stats AsyncSearchServer::GetStats() const {
+    return { completed_count_, failed_count_, rejected_count_, expired_count_, cancelled_count_ };
+}
+
+size_t AsyncSearchServer::GetQueueSize() const {
+    std::lock_guard queue_lock(queue_mutex_);
+    return queue_.size();
+}
+
+void AsyncSearchServer::RunWorker() {
+
+    SearchServer::QueryContext context;
+    while (true) {
+        Request request;
+        bool is_stopped = false;
+        {
+            std::unique_lock queue_lock(queue_mutex_);
+            queue_not_empty_.wait(queue_lock, [this] { return is_stopped_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            request = std::move(queue_.front());
+            queue_.pop_front();
+            is_stopped = is_stopped_;
+        }
+        queue_not_full_.notify_one();
+
+        if (is_stopped) {
+            Drop(request, QueryDroppedError::Reason::SHUTDOWN);
+            continue;
+        }
+        if (request.is_cancelled->load()) {
+            ++cancelled_count_;
+            Drop(request, QueryDroppedError::Reason::CANCELLED);
+            continue;
+        }
+        if (Clock::now() > request.deadline) {
+            ++expired_count_;
+            Drop(request, QueryDroppedError::Reason::DEADLINE_EXCEEDED);
+            continue;
+        }
+
+        // Counters are updated first, so they include every query whose result is ready
+        std::vector<Document> documents;
+        try {
+            documents = search_server_.FindTopDocuments(context, request.raw_query, request.status);
+        }
+        catch (...) {
+            ++failed_count_;
+            request.result.set_exception(std::current_exception());
+            continue;
+        }
+        ++completed_count_;
+        request.result.set_value(std::move(documents));
+    }
+}
+
+void AsyncSearchServer::Drop(Request& request, QueryDroppedError::Reason reason) {
+    request.result.set_exception(std::make_exception_ptr(QueryDroppedError(reason)));
+}
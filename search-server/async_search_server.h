@@ -0,0 +1,120 @@
+#pragma once
+#include "document.h"
+#include "search_server.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reported through the future of a query that was never run
+class QueryDroppedError : public std::runtime_error {
+public:
+    enum class Reason {
+        QUEUE_FULL,
+        DEADLINE_EXCEEDED,
+        CANCELLED,
+        SHUTDOWN,
+    };
+
+    explicit QueryDroppedError(Reason reason);
+
+    Reason GetReason() const;
+
+private:
+    Reason reason_;
+};
+
+// Asynchronous front-end for a SearchServer. Queries wait in a bounded queue and
+// a fixed number of workers run them one at a time each, with sequential search
+// and a reused QueryContext, so the load on the machine does not grow with the
+// number of callers. When the queue is full a query is either rejected at once or
+// its caller waits for a free slot. Queries whose deadline passes while they wait
+// are dropped instead of run, which keeps the latency of the rest bounded
+class AsyncSearchServer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class OverloadPolicy {
+        REJECT,
+        WAIT,
+    };
+
+    struct Options {
+        size_t worker_count = std::thread::hardware_concurrency();
+        size_t queue_capacity = 1024;
+        OverloadPolicy overload_policy = OverloadPolicy::REJECT;
+    };
+
+    // The server must outlive this object and must not change while queries run
+    AsyncSearchServer(const SearchServer& search_server, const Options& options);
+    explicit AsyncSearchServer(const SearchServer& search_server);
+    // Queued queries are dropped with Reason::SHUTDOWN, running ones finish
+    ~AsyncSearchServer();
+
+    AsyncSearchServer(const AsyncSearchServer&) = delete;
+    AsyncSearchServer& operator=(const AsyncSearchServer&) = delete;
+
+    struct QueryTicket {
+        std::future<std::vector<Document>> result;
+        std::shared_ptr<std::atomic<bool>> is_cancelled;
+
+        // Drops the query unless a worker has already taken it
+        void Cancel() const {
+            is_cancelled->store(true);
+        }
+    };
+
+    // The deadline is the time by which a worker has to take the query; a running
+    // query is not interrupted. Under OverloadPolicy::WAIT the call blocks at most
+    // until the deadline
+    QueryTicket Submit(std::string raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+        Clock::time_point deadline = Clock::time_point::max());
+
+    struct Stats {
+        uint64_t completed = 0;
+        uint64_t failed = 0;
+        uint64_t rejected = 0;
+        uint64_t expired = 0;
+        uint64_t cancelled = 0;
+    };
+
+    Stats GetStats() const;
+    size_t GetQueueSize() const;
+
+private:
+    struct Request {
+        std::string raw_query;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+        Clock::time_point deadline;
+        std::shared_ptr<std::atomic<bool>> is_cancelled;
+        std::promise<std::vector<Document>> result;
+    };
+
+    const SearchServer& search_server_;
+    const Options options_;
+
+    mutable std::mutex queue_mutex_;
+    std::condition_variable queue_not_empty_;
+    std::condition_variable queue_not_full_;
+    std::deque<Request> queue_;
+    bool is_stopped_ = false;
+
+    std::atomic<uint64_t> completed_count_ = 0;
+    std::atomic<uint64_t> failed_count_ = 0;
+    std::atomic<uint64_t> rejected_count_ = 0;
+    std::atomic<uint64_t> expired_count_ = 0;
+    std::atomic<uint64_t> cancelled_count_ = 0;
+
+    std::vector<std::thread> workers_;
+
+    void RunWorker();
+    void Drop(Request& request, QueryDroppedError::Reason reason);
+};
@@ -0,0 +1,215 @@
+#include "batch_query_executor.h"
+#include "top_documents.h"
+#include <algorithm>
+
+namespace {
+
+size_t CountWords(const std::string_view text) {
+    size_t word_count = 0;
+    bool is_in_word = false;
+    for (const char c : text) {
+        if (c == ' ') {
+            is_in_word = false;
+        }
+        else if (!is_in_word) {
+            is_in_word = true;
+            ++word_count;
+        }
+    }
+    return word_count;
+}
+
+}
+
+BatchQueryExecutor::BatchQueryExecutor(size_t worker_count)
+    : max_query_parallelism_(std::max<size_t>(1, worker_count))
+{
+    workers_.resize(std::max<size_t>(1, worker_count));
+    for (auto& worker : workers_) {
+        worker = std::make_unique<Worker>();
+    }
+    for (size_t worker = 0; worker < workers_.size(); ++worker) {
+        workers_[worker]->thread = std::thread([this, worker] { RunWorker(worker); });
+    }
+}
+
+BatchQueryExecutor::~BatchQueryExecutor() {
+    {
+        std::lock_guard state_lock(state_mutex_);
+        is_stopped_ = true;
+    }
+    state_condition_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+size_t BatchQueryExecutor::GetWorkerCount() const {
+    return workers_.size();
+}
+
+void BatchQueryExecutor::SetQuerySplitting(size_t min_split_word_count, size_t max_query_parallelism) {
+    std::lock_guard batch_lock(batch_mutex_);
+    min_split_word_count_ = min_split_word_count;
+    max_query_parallelism_ = std::max<size_t>(1, max_query_parallelism);
+}
+
+std::vector<std::vector<Document>> BatchQueryExecutor::ProcessQueries(const SearchServer& search_server,
+    const std::vector<std::string>& queries, BatchStats* stats) {
+
+    std::lock_guard batch_lock(batch_mutex_);
+
+    Batch batch;
+    batch.search_server = &search_server;
+    batch.queries = &queries;
+    batch.start_time = Clock::now();
+    batch.part_counts.resize(queries.size(), 1);
+    batch.part_results.resize(queries.size());
+    batch.remaining_parts = std::make_unique<std::atomic<size_t>[]>(queries.size());
+    batch.is_started = std::make_unique<std::atomic<bool>[]>(queries.size());
+    batch.query_start_times.resize(queries.size());
+    batch.latencies.resize(queries.size());
+    batch.results.resize(queries.size());
+    batch.errors.resize(queries.size());
+
+    // Tasks are queued before the batch is published, so a worker that finds every
+    // queue empty is done with the batch
+    const size_t part_limit = std::min(max_query_parallelism_, workers_.size());
+    for (size_t worker = 0; worker < workers_.size(); ++worker) {
+        const size_t first_query = queries.size() * worker / workers_.size();
+        const size_t last_query = queries.size() * (worker + 1) / workers_.size();
+        std::lock_guard worker_lock(workers_[worker]->mutex);
+        for (size_t query = first_query; query < last_query; ++query) {
+            if (part_limit > 1 && CountWords(queries[query]) >= min_split_word_count_) {
+                batch.part_counts[query] = part_limit;
+                batch.part_results[query].resize(part_limit);
+            }
+            batch.remaining_parts[query].store(batch.part_counts[query], std::memory_order_relaxed);
+            batch.is_started[query].store(false, std::memory_order_relaxed);
+            for (size_t part = 0; part < batch.part_counts[query]; ++part) {
+                workers_[worker]->tasks.push_back({ query, part });
+            }
+        }
+    }
+
+    {
+        std::unique_lock state_lock(state_mutex_);
+        batch_ = &batch;
+        ++batch_number_;
+        active_worker_count_ = workers_.size();
+        state_condition_.notify_all();
+        state_condition_.wait(state_lock, [this] { return active_worker_count_ == 0; });
+        batch_ = nullptr;
+    }
+
+    if (stats != nullptr) {
+        stats->query_count = queries.size();
+        stats->wall_time = Clock::now() - batch.start_time;
+        const double seconds = std::chrono::duration<double>(stats->wall_time).count();
+        stats->queries_per_second = seconds > 0.0 ? queries.size() / seconds : 0.0;
+        std::sort(batch.latencies.begin(), batch.latencies.end());
+        const size_t count = batch.latencies.size();
+        stats->median_latency = count > 0 ? batch.latencies[count / 2] : Clock::duration{};
+        stats->p99_latency = count > 0 ? batch.latencies[std::min(count - 1, count * 99 / 100)] : Clock::duration{};
+        stats->max_latency = count > 0 ? batch.latencies.back() : Clock::duration{};
+    }
+    for (const std::exception_ptr& error : batch.errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return std::move(batch.results);
+}
+
+void BatchQueryExecutor::RunWorker(size_t worker) {
+
+    uint64_t batch_number = 0;
+    while (true) {
+        Batch* batch = nullptr;
+        {
+            std::unique_lock state_lock(state_mutex_);
+            state_condition_.wait(state_lock, [this, batch_number] {
+                return is_stopped_ || batch_number_ != batch_number;
+            });
+            if (is_stopped_) {
+                return;
+            }
+            batch_number = batch_number_;
+            batch = batch_;
+        }
+
+        Task task;
+        while (TakeTask(worker, task)) {
+            RunTask(*workers_[worker], *batch, task);
+        }
+
+        std::lock_guard state_lock(state_mutex_);
+        if (--active_worker_count_ == 0) {
+            state_condition_.notify_all();
+        }
+    }
+}
+
+bool BatchQueryExecutor::TakeTask(size_t worker, Task& task) {
+    {
+        Worker& owner = *workers_[worker];
+        std::lock_guard worker_lock(owner.mutex);
+        if (!owner.tasks.empty()) {
+            task = owner.tasks.front();
+            owner.tasks.pop_front();
+            return true;
+        }
+    }
+    // Stealing from the back takes the work its owner would reach last
+    for (size_t i = 1; i < workers_.size(); ++i) {
+        Worker& victim = *workers_[(worker + i) % workers_.size()];
+        std::lock_guard worker_lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void BatchQueryExecutor::RunTask(Worker& worker, Batch& batch, const Task& task) {
+
+    if (!batch.is_started[task.query].exchange(true, std::memory_order_relaxed)) {
+        batch.query_start_times[task.query] = Clock::now();
+    }
+
+    const std::string& query = (*batch.queries)[task.query];
+    const size_t part_count = batch.part_counts[task.query];
+    try {
+        if (part_count == 1) {
+            batch.results[task.query] = batch.search_server->FindTopDocuments(worker.context, query);
+        }
+        else {
+            batch.part_results[task.query][task.part] = batch.search_server->FindTopDocumentsPart(worker.context,
+                query, DocumentFilter{}, task.part, part_count, MAX_RESULT_DOCUMENT_COUNT);
+        }
+    }
+    catch (...) {
+        std::lock_guard error_lock(batch.error_mutex);
+        if (!batch.errors[task.query]) {
+            batch.errors[task.query] = std::current_exception();
+        }
+    }
+
+    // The last part to finish sees the results and start time of all the others
+    if (batch.remaining_parts[task.query].fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    if (part_count > 1) {
+        TopDocumentsHeap heap(MAX_RESULT_DOCUMENT_COUNT);
+        for (const auto& part_result : batch.part_results[task.query]) {
+            for (const Document& document : part_result) {
+                heap.Push(document);
+            }
+        }
+        heap.ExtractTo(batch.results[task.query]);
+        batch.part_results[task.query] = {};
+    }
+    batch.latencies[task.query] = Clock::now() - batch.query_start_times[task.query];
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "document.h"
+#include "search_server.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs batches of queries on a fixed pool of workers. Every worker starts on its
+// own contiguous part of the batch and steals tasks from the others once it runs
+// out, so a few long queries do not leave the rest of the pool idle. Long queries
+// are additionally split into ordinal ranges that are scored as separate tasks
+class BatchQueryExecutor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit BatchQueryExecutor(size_t worker_count = std::thread::hardware_concurrency());
+    ~BatchQueryExecutor();
+
+    BatchQueryExecutor(const BatchQueryExecutor&) = delete;
+    BatchQueryExecutor& operator=(const BatchQueryExecutor&) = delete;
+
+    size_t GetWorkerCount() const;
+
+    // Queries of at least min_split_word_count words are scored in up to
+    // max_query_parallelism parts; 1 keeps every query on one worker
+    void SetQuerySplitting(size_t min_split_word_count, size_t max_query_parallelism);
+
+    struct BatchStats {
+        size_t query_count = 0;
+        Clock::duration wall_time{};
+        double queries_per_second = 0.0;
+        // Time from the start of the first task of a query to the end of its last one
+        Clock::duration median_latency{};
+        Clock::duration p99_latency{};
+        Clock::duration max_latency{};
+    };
+
+    // Same results as ProcessQueries, in the order of the queries. If a query is
+    // invalid, the whole batch still runs and the error of the earliest invalid
+    // query in the batch is rethrown, whichever worker ran into an error first.
+    // Batches run one at a time
+    std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server,
+        const std::vector<std::string>& queries, BatchStats* stats = nullptr);
+
+private:
+    struct Task {
+        size_t query = 0;
+        size_t part = 0;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        // The owner takes tasks from the front, thieves from the back
+        std::deque<Task> tasks;
+        SearchServer::QueryContext context;
+        std::thread thread;
+    };
+
+    struct Batch {
+        const SearchServer* search_server = nullptr;
+        const std::vector<std::string>* queries = nullptr;
+        Clock::time_point start_time;
+        std::vector<size_t> part_counts;
+        std::vector<std::vector<std::vector<Document>>> part_results;
+        std::unique_ptr<std::atomic<size_t>[]> remaining_parts;
+        std::unique_ptr<std::atomic<bool>[]> is_started;
+        std::vector<Clock::time_point> query_start_times;
+        std::vector<Clock::duration> latencies;
+        std::vector<std::vector<Document>> results;
+        // Parts of one query fail alike, so each query keeps the error of whichever part came first
+        std::mutex error_mutex;
+        std::vector<std::exception_ptr> errors;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    size_t min_split_word_count_ = 32;
+    size_t max_query_parallelism_;
+
+    std::mutex batch_mutex_;
+
+    // Guards the fields below, which hand batches to the workers
+    std::mutex state_mutex_;
+    std::condition_variable state_condition_;
+    Batch* batch_ = nullptr;
+    uint64_t batch_number_ = 0;
+    size_t active_worker_count_ = 0;
+    bool is_stopped_ = false;
+
+    void RunWorker(size_t worker);
+    bool TakeTask(size_t worker, Task& task);
+    void RunTask(Worker& worker, Batch& batch, const Task& task);
+};
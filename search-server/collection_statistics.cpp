@@ -0,0 +1,39 @@
+#include "collection_statistics.h"
+#include <cmath>
+
+double CollectionStatistics::GetLogDocumentCount() const {
+    return log_document_count_;
+}
+
+double CollectionStatistics::GetLogDocumentFreq(std::string_view word) const {
+    const TermId term = dictionary_.Find(word);
+    return term == TermDictionary::NO_TERM ? 0.0 : log_document_freqs_[term];
+}
+
+// Logarithms are taken exactly as SearchServer takes them, so IDFs are bit-identical
+
+void CollectionStatistics::AddWord(std::string_view word) {
+    const TermId term = dictionary_.Add(word);
+    if (term >= document_freqs_.size()) {
+        document_freqs_.resize(term + 1, 0);
+        log_document_freqs_.resize(term + 1, 0.0);
+    }
+    log_document_freqs_[term] = std::log(++document_freqs_[term]);
+}
+
+void CollectionStatistics::RemoveWord(std::string_view word) {
+    const TermId term = dictionary_.Find(word);
+    if (term == TermDictionary::NO_TERM) {
+        return;
+    }
+    if (--document_freqs_[term] == 0) {
+        log_document_freqs_[term] = 0.0;
+        dictionary_.Remove(term);
+        return;
+    }
+    log_document_freqs_[term] = std::log(document_freqs_[term]);
+}
+
+void CollectionStatistics::UpdateLogDocumentCount() {
+    log_document_count_ = document_count_ == 0 ? 0.0 : std::log(document_count_);
+}
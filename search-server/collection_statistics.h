@@ -0,0 +1,57 @@
+#pragma once
+#include "term_dictionary.h"
+#include <string_view>
+#include <vector>
+
+// Document count and per-word document frequencies of a collection split across
+// several servers. A server attached to it ranks with the IDF of the whole
+// collection instead of its own part, so its scores match a single server
+class CollectionStatistics {
+public:
+    CollectionStatistics() = default;
+
+    // words are the distinct words of the added or removed document
+    template <typename WordContainer>
+    void AddDocument(const WordContainer& words);
+    template <typename WordContainer>
+    void RemoveDocument(const WordContainer& words);
+
+    double GetLogDocumentCount() const;
+
+    // Returns 0 for words no document contains
+    double GetLogDocumentFreq(std::string_view word) const;
+
+private:
+    TermDictionary dictionary_;
+    // Indexed by term id
+    std::vector<int> document_freqs_;
+    std::vector<double> log_document_freqs_;
+    int document_count_ = 0;
+    double log_document_count_ = 0.0;
+
+    void AddWord(std::string_view word);
+    void RemoveWord(std::string_view word);
+    void UpdateLogDocumentCount();
+};
+
+
+//TEMPLATES --------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+template <typename WordContainer>
+void CollectionStatistics::AddDocument(const WordContainer& words) {
+    for (const std::string_view word : words) {
+        AddWord(word);
+    }
+    ++document_count_;
+    UpdateLogDocumentCount();
+}
+
+template <typename WordContainer>
+void CollectionStatistics::RemoveDocument(const WordContainer& words) {
+    for (const std::string_view word : words) {
+        RemoveWord(word);
+    }
+    --document_count_;
+    UpdateLogDocumentCount();
+}
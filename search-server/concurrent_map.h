@@ -1,3 +1,4 @@
+#pragma once
 #include <cstdlib>
 #include <map>
 #include <mutex>
@@ -41,6 +42,7 @@ public:
 
     void erase(const Key& key) {
         auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+        std::lock_guard g(bucket.mutex);
         bucket.map.erase(key);
     }
 
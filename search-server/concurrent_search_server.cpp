@@ -0,0 +1,191 @@
+#include "concurrent_search_server.h"
+#include <algorithm>
+
+ConcurrentSearchServer::~ConcurrentSearchServer() {
+    StopBackgroundMerging();
+}
+
+std::shared_ptr<const SearchServer> ConcurrentSearchServer::GetSnapshot() const {
+    for (;;) {
+        Instance* const instance = published_.load();
+        ++instance->entering_readers;
+        // Still published after the reader is counted, so the writer keeps the handle until it is copied
+        if (instance == published_.load()) {
+            std::shared_ptr<const SearchServer> snapshot = instance->handle;
+            --instance->entering_readers;
+            return snapshot;
+        }
+        --instance->entering_readers;
+    }
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return GetSnapshot()->GetDocumentCount();
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status,
+    const std::vector<int>& ratings) {
+
+    Update([document_id, text = std::string(document), status, ratings](SearchServer& server) {
+        server.AddDocument(document_id, text, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::AddDocuments(const std::vector<SearchServer::NewDocument>& documents) {
+
+    // The batch is replayed later, so texts are copied out of the caller's buffers
+    std::vector<std::string> texts;
+    texts.reserve(documents.size());
+    for (const SearchServer::NewDocument& document : documents) {
+        texts.emplace_back(document.text);
+    }
+    Update([batch = documents, texts = std::move(texts)](SearchServer& server) mutable {
+        for (size_t i = 0; i < batch.size(); ++i) {
+            batch[i].text = texts[i];
+        }
+        server.AddDocuments(batch);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Update([document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::Freeze(PostingFormat format) {
+    Update([format](SearchServer& server) {
+        server.Freeze(format);
+    });
+}
+
+void ConcurrentSearchServer::MergeDeltaSegment() {
+
+    std::shared_ptr<const SearchServer> snapshot = GetSnapshot();
+    if (!snapshot->IsFrozen() || snapshot->GetDeltaSegmentSize() == 0) {
+        return;
+    }
+    // A pinned version held for the whole merge would make writers copy the index
+    const SearchServer server(*snapshot);
+    snapshot.reset();
+
+    // Every instance commits the same merged index
+    auto merge = std::make_shared<const SearchServer::SegmentMerge>(server.PrepareSegmentMerge());
+    Update([merge](SearchServer& server) {
+        server.CommitSegmentMerge(*merge);
+    });
+}
+
+void ConcurrentSearchServer::StartBackgroundMerging(size_t min_delta_size, std::chrono::milliseconds period) {
+
+    StopBackgroundMerging();
+    is_merging_stopped_ = false;
+    merge_thread_ = std::thread([this, min_delta_size, period] {
+        std::unique_lock merge_lock(merge_mutex_);
+        while (!merge_condition_.wait_for(merge_lock, period, [this] { return is_merging_stopped_; })) {
+            merge_lock.unlock();
+            if (GetSnapshot()->GetDeltaSegmentSize() >= min_delta_size) {
+                MergeDeltaSegment();
+            }
+            merge_lock.lock();
+        }
+    });
+}
+
+void ConcurrentSearchServer::StopBackgroundMerging() {
+    if (!merge_thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard merge_lock(merge_mutex_);
+        is_merging_stopped_ = true;
+    }
+    merge_condition_.notify_all();
+    merge_thread_.join();
+}
+
+void ConcurrentSearchServer::Update(std::function<void(SearchServer&)> change) {
+
+    std::lock_guard update_lock(update_mutex_);
+
+    Instance& standby = GetStandby();
+    SearchServer& server = *standby.server;
+    for (; standby.change_count < first_change_ + changes_.size(); ++standby.change_count) {
+        changes_[standby.change_count - first_change_](server);
+    }
+    // A change that throws leaves the instance as it is, ready for the next one
+    change(server);
+    changes_.push_back(std::move(change));
+    ++standby.change_count;
+
+    Publish(standby);
+    TrimChanges();
+}
+
+ConcurrentSearchServer::Instance& ConcurrentSearchServer::GetStandby() {
+
+    ReleaseRetiredInstances();
+
+    Instance* const published = published_.load();
+    Instance* standby = nullptr;
+    Instance* unused = nullptr;
+    for (Instance& instance : instances_) {
+        if (&instance == published || instance.handle || instance.is_pinned.load()) {
+            continue;
+        }
+        if (!instance.server) {
+            unused = unused == nullptr ? &instance : unused;
+        }
+        else if (standby == nullptr || standby->change_count < instance.change_count) {
+            standby = &instance;
+        }
+    }
+    // Only the free instance that has seen the most changes keeps its server
+    for (Instance& instance : instances_) {
+        if (&instance != published && &instance != standby && !instance.handle && !instance.is_pinned.load()) {
+            instance.server.reset();
+        }
+    }
+    if (standby != nullptr) {
+        return *standby;
+    }
+
+    // Readers still hold every retired instance
+    if (unused == nullptr) {
+        unused = &instances_.emplace_back();
+    }
+    unused->server = std::make_unique<SearchServer>(*published->server);
+    unused->change_count = published->change_count;
+    return *unused;
+}
+
+void ConcurrentSearchServer::Publish(Instance& instance) {
+    instance.is_pinned = true;
+    instance.handle = std::shared_ptr<const SearchServer>(instance.server.get(), [&instance](const SearchServer*) {
+        instance.is_pinned = false;
+    });
+    published_.store(&instance);
+    ReleaseRetiredInstances();
+}
+
+void ConcurrentSearchServer::ReleaseRetiredInstances() {
+    Instance* const published = published_.load();
+    for (Instance& instance : instances_) {
+        // A reader that loaded the instance before it was retired may still be copying the handle
+        if (&instance != published && instance.handle && instance.entering_readers.load() == 0) {
+            instance.handle.reset();
+        }
+    }
+}
+
+void ConcurrentSearchServer::TrimChanges() {
+    size_t change_count = first_change_ + changes_.size();
+    for (const Instance& instance : instances_) {
+        if (instance.server) {
+            change_count = std::min(change_count, instance.change_count);
+        }
+    }
+    for (; first_change_ < change_count; ++first_change_) {
+        changes_.pop_front();
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "document.h"
+#include "search_server.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// SearchServer that answers queries while it is being updated. Readers pin the
+// published version without locks and never wait for writers, and writers never
+// wait for readers. Writers are serialized and work on a standby instance, which is
+// then published. A retired instance becomes the standby again once no reader holds
+// it and catches up by replaying the changes it missed; while it is still held, the
+// next update copies the published instance instead
+class ConcurrentSearchServer {
+public:
+    template <typename StopWords>
+    explicit ConcurrentSearchServer(const StopWords& stop_words);
+
+    ConcurrentSearchServer(const ConcurrentSearchServer&) = delete;
+    ConcurrentSearchServer& operator=(const ConcurrentSearchServer&) = delete;
+    ~ConcurrentSearchServer();
+
+    // The pinned version stays unchanged while the pointer is held, and the pointer must
+    // be released before the server is destroyed. Every version that is still held when
+    // it is retired keeps a copy of the index alive, so snapshots are meant to be held
+    // for a few queries rather than across updates
+    std::shared_ptr<const SearchServer> GetSnapshot() const;
+
+    // Same overloads as SearchServer, each call runs against one pinned version.
+    // MatchDocument returns words of the version's dictionary, so it is called on a snapshot
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const;
+
+    int GetDocumentCount() const;
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status,
+        const std::vector<int>& ratings);
+    void AddDocuments(const std::vector<SearchServer::NewDocument>& documents);
+    void RemoveDocument(int document_id);
+    void Freeze(PostingFormat format = PostingFormat::PLAIN);
+
+    // Merges the delta segment of a frozen server into a new main segment. The merged
+    // index is built from a private copy of the published version, so writers go on
+    // meanwhile; it is then committed as an update and changes made in between stay
+    // in the delta
+    void MergeDeltaSegment();
+
+    // Checks every period whether the delta segment holds at least min_delta_size
+    // changes and merges it on a background thread if so
+    void StartBackgroundMerging(size_t min_delta_size, std::chrono::milliseconds period);
+    void StopBackgroundMerging();
+
+    // Applies change to a new version and publishes it. The change may run again on
+    // other instances, so it must be deterministic, own its arguments and leave the
+    // server unchanged if it throws, as SearchServer's own methods do
+    void Update(std::function<void(SearchServer&)> change);
+
+private:
+    // One version of the server. Instances live as long as the server, so a reader may
+    // always touch the counters of one it has loaded; the server of an unused instance is freed
+    struct Instance {
+        std::unique_ptr<SearchServer> server;
+        // Changes of the log that server has seen
+        size_t change_count = 0;
+        // Readers between loading published_ and copying handle
+        std::atomic<int> entering_readers = 0;
+        // Cleared by the deleter of handle once the last reader is gone
+        std::atomic<bool> is_pinned = false;
+        // Copied by readers; reset once the instance is retired and no reader is entering it
+        std::shared_ptr<const SearchServer> handle;
+    };
+
+    std::mutex update_mutex_;
+    // A deque keeps instances in place
+    std::deque<Instance> instances_;
+    std::atomic<Instance*> published_ = nullptr;
+    // Changes not yet seen by some instance with a server; the front one is change first_change_
+    std::deque<std::function<void(SearchServer&)>> changes_;
+    size_t first_change_ = 0;
+
+    std::thread merge_thread_;
+    std::mutex merge_mutex_;
+    std::condition_variable merge_condition_;
+    bool is_merging_stopped_ = false;
+
+    // A retired instance that no reader holds, or a copy of the published one
+    Instance& GetStandby();
+    void Publish(Instance& instance);
+    void ReleaseRetiredInstances();
+    void TrimChanges();
+};
+
+
+//TEMPLATES --------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+template <typename StopWords>
+ConcurrentSearchServer::ConcurrentSearchServer(const StopWords& stop_words) {
+    Instance& instance = instances_.emplace_back();
+    instance.server = std::make_unique<SearchServer>(stop_words);
+    Publish(instance);
+}
+
+template <typename... Args>
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(Args&&... args) const {
+    return GetSnapshot()->FindTopDocuments(std::forward<Args>(args)...);
+}
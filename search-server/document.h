@@ -1,4 +1,5 @@
 #pragma once
+#include <limits>
 #include <ostream>
 
 struct Document {
@@ -19,4 +20,13 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+const int DOCUMENT_STATUS_COUNT = 4;
+
+// Documents with the status and an average rating within [min_rating, max_rating]
+struct DocumentFilter {
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    int min_rating = std::numeric_limits<int>::min();
+    int max_rating = std::numeric_limits<int>::max();
+};
+
 std::ostream& operator<<(std::ostream& out, const Document& iter);
@@ -0,0 +1,173 @@
+#include "frozen_index.h"
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+FrozenIndex::FrozenIndex(const std::vector<WordPostings>& term_postings, PostingFormat format,
+    const MappedArray<uint32_t>& word_counts)
+    : format_(format)
+{
+    std::vector<double> log_document_freqs;
+    std::vector<uint64_t> offsets;
+    log_document_freqs.reserve(term_postings.size());
+    offsets.reserve(term_postings.size() + 1);
+
+    offsets.push_back(0);
+    for (const WordPostings& postings : term_postings) {
+        log_document_freqs.push_back(postings.log_document_freq);
+        offsets.push_back(offsets.back() + postings.ordinal_freqs.size());
+    }
+    log_document_freqs_ = MappedArray<double>(std::move(log_document_freqs));
+    offsets_ = MappedArray<uint64_t>(std::move(offsets));
+
+    std::vector<double> max_term_freqs(term_postings.size(), 0.0);
+    for (TermId term = 0; term < term_postings.size(); ++term) {
+        for (const auto [ordinal, term_freq] : term_postings[term].ordinal_freqs) {
+            max_term_freqs[term] = std::max(max_term_freqs[term], term_freq);
+        }
+    }
+    max_term_freqs_ = MappedArray<double>(std::move(max_term_freqs));
+
+    if (format_ == PostingFormat::COMPRESSED) {
+        Compress(term_postings, word_counts);
+    }
+    else {
+        std::vector<int> ordinals;
+        std::vector<double> term_freqs;
+        ordinals.reserve(offsets_[term_postings.size()]);
+        term_freqs.reserve(offsets_[term_postings.size()]);
+        for (const WordPostings& postings : term_postings) {
+            for (const auto [ordinal, term_freq] : postings.ordinal_freqs) {
+                ordinals.push_back(ordinal);
+                term_freqs.push_back(term_freq);
+            }
+        }
+        ordinals_ = MappedArray<int>(std::move(ordinals));
+        term_freqs_ = MappedArray<double>(std::move(term_freqs));
+    }
+}
+
+FrozenIndex::FrozenIndex(MappedArray<double> log_document_freqs, MappedArray<double> max_term_freqs,
+    MappedArray<uint64_t> offsets, MappedArray<int> ordinals, MappedArray<double> term_freqs)
+    : log_document_freqs_(std::move(log_document_freqs))
+    , max_term_freqs_(std::move(max_term_freqs))
+    , offsets_(std::move(offsets))
+    , ordinals_(std::move(ordinals))
+    , term_freqs_(std::move(term_freqs))
+{
+}
+
+PostingFormat FrozenIndex::GetFormat() const {
+    return format_;
+}
+
+size_t FrozenIndex::GetPostingCount(TermId term) const {
+    return term < GetTermCount() ? offsets_[term + 1] - offsets_[term] : 0;
+}
+
+double FrozenIndex::GetLogDocumentFreq(TermId term) const {
+    return term < GetTermCount() ? log_document_freqs_[term] : 0.0;
+}
+
+double FrozenIndex::GetMaxTermFreq(TermId term) const {
+    return term < GetTermCount() ? max_term_freqs_[term] : 0.0;
+}
+
+FrozenIndex::Cursor FrozenIndex::GetCursor(TermId term, int first_ordinal) const {
+
+    Cursor cursor;
+    cursor.index_ = this;
+    if (term >= GetTermCount() || offsets_[term] == offsets_[term + 1]) {
+        return cursor;
+    }
+    cursor.first_posting_ = offsets_[term];
+    cursor.last_posting_ = offsets_[term + 1];
+
+    if (format_ == PostingFormat::PLAIN) {
+        cursor.posting_ = cursor.first_posting_;
+        cursor.ordinal_ = ordinals_[cursor.posting_];
+    }
+    else {
+        cursor.first_block_ = block_offsets_[term];
+        cursor.block_ = cursor.first_block_;
+        cursor.last_block_ = block_offsets_[term + 1];
+        cursor.LoadBlock();
+    }
+    cursor.SkipTo(first_ordinal);
+    return cursor;
+}
+
+bool FrozenIndex::HasDocument(TermId term, int ordinal) const {
+    bool has_document = false;
+    ForEachPosting(term, ordinal, ordinal + 1, [&has_document](int, double) {
+        has_document = true;
+    });
+    return has_document;
+}
+
+size_t FrozenIndex::GetTermCount() const {
+    return log_document_freqs_.size();
+}
+
+std::vector<WordPostings> FrozenIndex::BuildPostings() const {
+    std::vector<WordPostings> result(GetTermCount());
+    for (TermId term = 0; term < result.size(); ++term) {
+        result[term].log_document_freq = log_document_freqs_[term];
+        auto& documents = result[term].ordinal_freqs;
+        ForEachPosting(term, 0, std::numeric_limits<int>::max(), [&documents](int ordinal, double term_freq) {
+            documents.emplace_hint(documents.end(), ordinal, term_freq);
+        });
+    }
+    return result;
+}
+
+void FrozenIndex::Compress(const std::vector<WordPostings>& term_postings, const MappedArray<uint32_t>& word_counts) {
+
+    using namespace std::string_literals;
+
+    inv_word_counts_.reserve(word_counts.size());
+    for (const uint32_t word_count : word_counts) {
+        inv_word_counts_.push_back(1.0 / word_count);
+    }
+
+    const size_t posting_count = offsets_[term_postings.size()];
+    block_offsets_.reserve(term_postings.size() + 1);
+    posting_bytes_.reserve(posting_count * 3);
+
+    block_offsets_.push_back(0);
+    for (const WordPostings& postings : term_postings) {
+        size_t block_fill = BLOCK_SIZE;
+        int previous_ordinal = 0;
+        for (const auto [ordinal, term_freq] : postings.ordinal_freqs) {
+            if (ordinal < 0 || static_cast<size_t>(ordinal) >= word_counts.size()) {
+                throw std::invalid_argument("No word count for ordinal "s + std::to_string(ordinal));
+            }
+            // Frequencies come from ComputeTermFreq, so the rounded count gives them back
+            const uint32_t count = static_cast<uint32_t>(std::lround(term_freq * word_counts[ordinal]));
+            if (ComputeTermFreq(count, inv_word_counts_[ordinal]) != term_freq) {
+                throw std::invalid_argument("Term frequency is not a whole number of occurrences"s);
+            }
+            if (block_fill == BLOCK_SIZE) {
+                block_first_ordinals_.push_back(ordinal);
+                block_byte_offsets_.push_back(posting_bytes_.size());
+                previous_ordinal = ordinal;
+                block_fill = 0;
+            }
+            WriteVarint(static_cast<uint32_t>(ordinal - previous_ordinal), posting_bytes_);
+            WriteVarint(count, posting_bytes_);
+            previous_ordinal = ordinal;
+            ++block_fill;
+        }
+        block_offsets_.push_back(block_first_ordinals_.size());
+    }
+    posting_bytes_.shrink_to_fit();
+}
+
+void FrozenIndex::WriteVarint(uint32_t value, std::vector<uint8_t>& bytes) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
@@ -0,0 +1,239 @@
+#pragma once
+#include "mapped_array.h"
+#include "term_dictionary.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <vector>
+
+// Posting list of a term in the mutable index: term frequency per document ordinal
+// and the logarithm of the document frequency, kept up to date on every change
+struct WordPostings {
+    std::map<int, double> ordinal_freqs;
+    double log_document_freq = 0.0;
+};
+
+// Share of a document's words taken by a term that occurs count times in it. Every
+// term frequency of the server is computed here, so a count gives back the exact value
+inline double ComputeTermFreq(uint32_t count, double inv_word_count) {
+    return count * inv_word_count;
+}
+
+enum class PostingFormat {
+    // Ordinals and term frequencies as plain arrays, results are exact
+    PLAIN,
+    // Delta + varint ordinals and occurrence counts in blocks with skip entries: about
+    // 3 bytes per posting instead of 12, plus 8 bytes per document. Term frequencies are
+    // rebuilt exactly from the counts, so results equal PLAIN ones
+    COMPRESSED,
+};
+
+// Read-only inverted index: posting lists of all term ids packed into contiguous
+// arrays (CSR layout), so a posting walk is a linear scan instead of a tree traversal.
+// PLAIN arrays may also point straight into a memory-mapped snapshot.
+class FrozenIndex {
+public:
+    class Cursor;
+
+    FrozenIndex() = default;
+
+    // term_postings is indexed by term id. COMPRESSED stores occurrence counts instead of
+    // term frequencies and needs the word count of every document ordinal of the postings
+    explicit FrozenIndex(const std::vector<WordPostings>& term_postings,
+        PostingFormat format = PostingFormat::PLAIN, const MappedArray<uint32_t>& word_counts = {});
+
+    // PLAIN index over existing arrays; offsets has one more element than there are terms
+    FrozenIndex(MappedArray<double> log_document_freqs, MappedArray<double> max_term_freqs,
+        MappedArray<uint64_t> offsets, MappedArray<int> ordinals, MappedArray<double> term_freqs);
+
+    PostingFormat GetFormat() const;
+
+    // Terms without postings, including ids the index has never seen, give empty results
+    size_t GetPostingCount(TermId term) const;
+    double GetLogDocumentFreq(TermId term) const;
+    // Upper bound of the term frequencies a posting walk of the term returns
+    double GetMaxTermFreq(TermId term) const;
+    bool HasDocument(TermId term, int ordinal) const;
+
+    // Cursor at the first posting of the term with an ordinal not less than first_ordinal
+    Cursor GetCursor(TermId term, int first_ordinal) const;
+
+    // Calls function(ordinal, term_freq) for postings of the term with ordinals in [first_ordinal, last_ordinal)
+    template <typename Function>
+    void ForEachPosting(TermId term, int first_ordinal, int last_ordinal, Function function) const;
+
+    size_t GetTermCount() const;
+
+    std::vector<WordPostings> BuildPostings() const;
+
+private:
+    static const size_t BLOCK_SIZE = 128;
+
+    PostingFormat format_ = PostingFormat::PLAIN;
+    MappedArray<double> log_document_freqs_;
+    MappedArray<double> max_term_freqs_;
+    // Position of every term's first posting, used by both formats
+    MappedArray<uint64_t> offsets_;
+
+    // PLAIN
+    MappedArray<int> ordinals_;
+    MappedArray<double> term_freqs_;
+
+    // COMPRESSED: every term's postings are split into blocks of BLOCK_SIZE. A block
+    // starts with a delta from its skip entry, so a walk can start at any block; every
+    // ordinal delta is followed by the occurrence count of the term in the document
+    std::vector<uint64_t> block_offsets_;
+    std::vector<int> block_first_ordinals_;
+    std::vector<uint64_t> block_byte_offsets_;
+    std::vector<uint8_t> posting_bytes_;
+    // Indexed by ordinal
+    std::vector<double> inv_word_counts_;
+
+    void Compress(const std::vector<WordPostings>& term_postings, const MappedArray<uint32_t>& word_counts);
+
+    static void WriteVarint(uint32_t value, std::vector<uint8_t>& bytes);
+    static uint32_t ReadVarint(const uint8_t*& bytes);
+};
+
+
+// Forward iterator over one posting list that can also skip ahead, for
+// document-at-a-time scoring. Past the end GetOrdinal() returns END
+class FrozenIndex::Cursor {
+public:
+    static const int END = std::numeric_limits<int>::max();
+
+    Cursor() = default;
+
+    int GetOrdinal() const {
+        return ordinal_;
+    }
+
+    double GetTermFreq() const {
+        if (index_->format_ == PostingFormat::PLAIN) {
+            return index_->term_freqs_[posting_];
+        }
+        return ComputeTermFreq(count_, index_->inv_word_counts_[ordinal_]);
+    }
+
+    void Next() {
+        ++posting_;
+        if (index_->format_ == PostingFormat::PLAIN) {
+            ordinal_ = posting_ < last_posting_ ? index_->ordinals_[posting_] : END;
+        }
+        else if (posting_ < block_last_posting_) {
+            ordinal_ += static_cast<int>(ReadVarint(bytes_));
+            count_ = ReadVarint(bytes_);
+        }
+        else if (++block_ < last_block_) {
+            LoadBlock();
+        }
+        else {
+            ordinal_ = END;
+        }
+    }
+
+    // Moves to the first posting with an ordinal not less than target
+    void SkipTo(int target) {
+        if (ordinal_ >= target) {
+            return;
+        }
+        if (index_->format_ == PostingFormat::PLAIN) {
+            const int* const ordinals = index_->ordinals_.data();
+            posting_ = std::lower_bound(ordinals + posting_, ordinals + last_posting_, target) - ordinals;
+            ordinal_ = posting_ < last_posting_ ? ordinals[posting_] : END;
+            return;
+        }
+        const uint64_t block = block_;
+        while (block_ + 1 < last_block_ && index_->block_first_ordinals_[block_ + 1] <= target) {
+            ++block_;
+        }
+        if (block_ != block) {
+            LoadBlock();
+        }
+        while (ordinal_ < target) {
+            Next();
+        }
+    }
+
+private:
+    friend class FrozenIndex;
+
+    const FrozenIndex* index_ = nullptr;
+    int ordinal_ = END;
+    uint64_t posting_ = 0;
+    uint64_t last_posting_ = 0;
+    // COMPRESSED only
+    uint64_t first_block_ = 0;
+    uint64_t block_ = 0;
+    uint64_t last_block_ = 0;
+    uint64_t first_posting_ = 0;
+    uint64_t block_last_posting_ = 0;
+    uint32_t count_ = 0;
+    const uint8_t* bytes_ = nullptr;
+
+    void LoadBlock() {
+        bytes_ = index_->posting_bytes_.data() + index_->block_byte_offsets_[block_];
+        posting_ = first_posting_ + (block_ - first_block_) * BLOCK_SIZE;
+        block_last_posting_ = std::min<uint64_t>(last_posting_, posting_ + BLOCK_SIZE);
+        ordinal_ = index_->block_first_ordinals_[block_] + static_cast<int>(ReadVarint(bytes_));
+        count_ = ReadVarint(bytes_);
+    }
+};
+
+
+//TEMPLATES --------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+inline uint32_t FrozenIndex::ReadVarint(const uint8_t*& bytes) {
+    uint32_t value = *bytes & 0x7F;
+    for (int shift = 7; *bytes++ & 0x80; shift += 7) {
+        value |= static_cast<uint32_t>(*bytes & 0x7F) << shift;
+    }
+    return value;
+}
+
+template <typename Function>
+void FrozenIndex::ForEachPosting(TermId term, int first_ordinal, int last_ordinal, Function function) const {
+
+    if (term >= GetTermCount()) {
+        return;
+    }
+
+    if (format_ == PostingFormat::PLAIN) {
+        const int* const begin = ordinals_.data() + offsets_[term];
+        const int* const end = ordinals_.data() + offsets_[term + 1];
+        for (const int* it = std::lower_bound(begin, end, first_ordinal); it != end && *it < last_ordinal; ++it) {
+            function(*it, term_freqs_[it - ordinals_.data()]);
+        }
+        return;
+    }
+
+    // Start from the last block that begins at or before first_ordinal
+    const auto first_block = block_first_ordinals_.begin() + block_offsets_[term];
+    const auto last_block = block_first_ordinals_.begin() + block_offsets_[term + 1];
+    auto block = std::upper_bound(first_block, last_block, first_ordinal);
+    if (block != first_block) {
+        --block;
+    }
+
+    for (; block != last_block && *block < last_ordinal; ++block) {
+        const size_t block_index = block - block_first_ordinals_.begin();
+        const uint8_t* bytes = posting_bytes_.data() + block_byte_offsets_[block_index];
+        const uint64_t first_posting = offsets_[term] + (block - first_block) * BLOCK_SIZE;
+        const uint64_t last_posting = std::min<uint64_t>(offsets_[term + 1], first_posting + BLOCK_SIZE);
+
+        int ordinal = *block;
+        for (uint64_t posting = first_posting; posting < last_posting; ++posting) {
+            ordinal += static_cast<int>(ReadVarint(bytes));
+            const uint32_t count = ReadVarint(bytes);
+            if (ordinal >= last_ordinal) {
+                return;
+            }
+            if (ordinal >= first_ordinal) {
+                function(ordinal, ComputeTermFreq(count, inv_word_counts_[ordinal]));
+            }
+        }
+    }
+}
@@ -0,0 +1,345 @@
+#include "index_snapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using namespace std::string_literals;
+
+const char SNAPSHOT_MAGIC[8] = { 'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P' };
+const uint32_t SNAPSHOT_VERSION = 4;
+const size_t SECTION_ALIGNMENT = 8;
+
+static_assert(sizeof(DocumentStatus) == sizeof(int32_t), "DocumentStatus is stored as int32_t");
+static_assert(sizeof(std::pair<TermId, uint32_t>) == 2 * sizeof(uint32_t), "Forward entries are stored without padding");
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t stop_word_count;
+    uint64_t stop_word_chars;
+    uint64_t term_count;
+    uint64_t term_chars;
+    uint64_t posting_count;
+    uint64_t document_count;
+    uint64_t forward_count;
+    double log_document_count;
+};
+
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path)
+        : out_(path, std::ios::binary | std::ios::trunc)
+    {
+        if (!out_) {
+            throw std::runtime_error("Cannot create snapshot file "s + path);
+        }
+    }
+
+    template <typename T>
+    void Write(const T* data, size_t count) {
+        out_.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(sizeof(T) * count));
+        offset_ += sizeof(T) * count;
+        while (offset_ % SECTION_ALIGNMENT != 0) {
+            out_.put('\0');
+            ++offset_;
+        }
+    }
+
+    // Strings are stored as count + 1 offsets followed by the concatenated characters
+    void WriteStrings(const std::vector<std::string_view>& strings) {
+        std::vector<uint64_t> offsets;
+        offsets.reserve(strings.size() + 1);
+        std::string chars;
+        offsets.push_back(0);
+        for (const std::string_view str : strings) {
+            chars += str;
+            offsets.push_back(chars.size());
+        }
+        Write(offsets.data(), offsets.size());
+        Write(chars.data(), chars.size());
+    }
+
+    void Finish() {
+        out_.flush();
+        if (!out_) {
+            throw std::runtime_error("Failed to write snapshot file"s);
+        }
+    }
+
+private:
+    std::ofstream out_;
+    size_t offset_ = 0;
+};
+
+class SnapshotReader {
+public:
+    SnapshotReader(const char* data, size_t size)
+        : data_(data)
+        , size_(size)
+    {
+    }
+
+    template <typename T>
+    MappedArray<T> Read(size_t count) {
+        const T* begin = reinterpret_cast<const T*>(Take(sizeof(T) * count));
+        return MappedArray<T>(begin, count);
+    }
+
+    std::vector<std::string_view> ReadStrings(size_t count, size_t char_count) {
+        const auto offsets = Read<uint64_t>(count + 1);
+        const char* chars = Take(char_count);
+        if (offsets[count] != char_count) {
+            throw std::runtime_error("Corrupted snapshot string table"s);
+        }
+
+        std::vector<std::string_view> strings;
+        strings.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (offsets[i] > offsets[i + 1] || offsets[i + 1] > char_count) {
+                throw std::runtime_error("Corrupted snapshot string table"s);
+            }
+            strings.emplace_back(chars + offsets[i], offsets[i + 1] - offsets[i]);
+        }
+        return strings;
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t offset_ = 0;
+
+    const char* Take(size_t bytes) {
+        if (bytes > size_ - offset_) {
+            throw std::runtime_error("Truncated snapshot file"s);
+        }
+        const char* result = data_ + offset_;
+        offset_ += bytes;
+        offset_ = std::min(size_, (offset_ + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT);
+        return result;
+    }
+};
+
+// Offsets of a CSR section must not decrease and must end at the size of the section
+void CheckOffsets(const MappedArray<uint64_t>& offsets, uint64_t count) {
+    for (size_t i = 1; i < offsets.size(); ++i) {
+        if (offsets[i] < offsets[i - 1]) {
+            throw std::runtime_error("Corrupted snapshot offsets"s);
+        }
+    }
+    if (offsets[0] != 0 || offsets[offsets.size() - 1] != count) {
+        throw std::runtime_error("Corrupted snapshot offsets"s);
+    }
+}
+
+} // namespace
+
+void IndexSnapshot::Write(const std::string& path, const Contents& contents) {
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.stop_word_count = contents.stop_words.size();
+    for (const std::string_view word : contents.stop_words) {
+        header.stop_word_chars += word.size();
+    }
+    header.term_count = contents.terms.size();
+    for (const std::string_view term : contents.terms) {
+        header.term_chars += term.size();
+    }
+    header.posting_count = contents.posting_ordinals.size();
+    header.document_count = contents.document_ids.size();
+    header.forward_count = contents.forward_term_counts.size();
+    header.log_document_count = contents.log_document_count;
+
+    SnapshotWriter writer(path);
+    writer.Write(&header, 1);
+    writer.WriteStrings(contents.stop_words);
+    writer.WriteStrings(contents.terms);
+    writer.Write(contents.log_document_freqs.data(), contents.log_document_freqs.size());
+    writer.Write(contents.max_term_freqs.data(), contents.max_term_freqs.size());
+    writer.Write(contents.posting_offsets.data(), contents.posting_offsets.size());
+    writer.Write(contents.posting_ordinals.data(), contents.posting_ordinals.size());
+    writer.Write(contents.posting_term_freqs.data(), contents.posting_term_freqs.size());
+    writer.Write(contents.document_ids.data(), contents.document_ids.size());
+    writer.Write(contents.document_ratings.data(), contents.document_ratings.size());
+    writer.Write(contents.document_statuses.data(), contents.document_statuses.size());
+    writer.Write(contents.document_word_counts.data(), contents.document_word_counts.size());
+    writer.Write(contents.document_status_bitmaps.data(), contents.document_status_bitmaps.size());
+    writer.Write(contents.forward_offsets.data(), contents.forward_offsets.size());
+    writer.Write(contents.forward_term_counts.data(), contents.forward_term_counts.size());
+    writer.Finish();
+}
+
+IndexSnapshot::IndexSnapshot(const std::string& path) {
+    Map(path);
+    try {
+        Parse();
+    }
+    catch (...) {
+        Unmap();
+        throw;
+    }
+}
+
+IndexSnapshot::~IndexSnapshot() {
+    Unmap();
+}
+
+const IndexSnapshot::Contents& IndexSnapshot::GetContents() const {
+    return contents_;
+}
+
+#ifdef _WIN32
+
+void IndexSnapshot::Map(const std::string& path) {
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        file_ = nullptr;
+        throw std::runtime_error("Cannot open snapshot file "s + path);
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_, &file_size) || file_size.QuadPart == 0) {
+        Unmap();
+        throw std::runtime_error("Cannot read snapshot file "s + path);
+    }
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ != nullptr) {
+        data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (data_ == nullptr) {
+        Unmap();
+        throw std::runtime_error("Cannot map snapshot file "s + path);
+    }
+    size_ = static_cast<size_t>(file_size.QuadPart);
+}
+
+void IndexSnapshot::Unmap() {
+    if (data_ != nullptr) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_ != nullptr) {
+        CloseHandle(mapping_);
+    }
+    if (file_ != nullptr) {
+        CloseHandle(file_);
+    }
+    data_ = nullptr;
+    mapping_ = nullptr;
+    file_ = nullptr;
+    size_ = 0;
+}
+
+#else
+
+void IndexSnapshot::Map(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open snapshot file "s + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("Cannot read snapshot file "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        size_ = 0;
+        throw std::runtime_error("Cannot map snapshot file "s + path);
+    }
+    data_ = static_cast<const char*>(data);
+}
+
+void IndexSnapshot::Unmap() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
+
+void IndexSnapshot::Parse() {
+
+    SnapshotReader reader(data_, size_);
+
+    const SnapshotHeader& header = reader.Read<SnapshotHeader>(1)[0];
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw std::runtime_error("Not a search server snapshot"s);
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw std::runtime_error("Unsupported snapshot version "s + std::to_string(header.version));
+    }
+
+    contents_.stop_words = reader.ReadStrings(header.stop_word_count, header.stop_word_chars);
+    contents_.terms = reader.ReadStrings(header.term_count, header.term_chars);
+    contents_.log_document_freqs = reader.Read<double>(header.term_count);
+    contents_.max_term_freqs = reader.Read<double>(header.term_count);
+    contents_.posting_offsets = reader.Read<uint64_t>(header.term_count + 1);
+    contents_.posting_ordinals = reader.Read<int>(header.posting_count);
+    contents_.posting_term_freqs = reader.Read<double>(header.posting_count);
+    contents_.document_ids = reader.Read<int>(header.document_count);
+    contents_.document_ratings = reader.Read<int>(header.document_count);
+    contents_.document_statuses = reader.Read<DocumentStatus>(header.document_count);
+    contents_.document_word_counts = reader.Read<uint32_t>(header.document_count);
+    contents_.document_status_bitmaps = reader.Read<uint64_t>(
+        DOCUMENT_STATUS_COUNT * OrdinalBitmap::GetWordCount(header.document_count));
+    contents_.forward_offsets = reader.Read<uint64_t>(header.document_count + 1);
+    contents_.forward_term_counts = reader.Read<std::pair<TermId, uint32_t>>(header.forward_count);
+    contents_.log_document_count = header.log_document_count;
+
+    CheckOffsets(contents_.posting_offsets, header.posting_count);
+    CheckOffsets(contents_.forward_offsets, header.forward_count);
+
+    // Every posting list is sorted by ordinal and every document by term id
+    for (uint64_t term = 0; term < header.term_count; ++term) {
+        for (uint64_t i = contents_.posting_offsets[term]; i < contents_.posting_offsets[term + 1]; ++i) {
+            const int ordinal = contents_.posting_ordinals[i];
+            if (ordinal < 0 || static_cast<uint64_t>(ordinal) >= header.document_count
+                || (i > contents_.posting_offsets[term] && ordinal <= contents_.posting_ordinals[i - 1])) {
+                throw std::runtime_error("Corrupted snapshot postings"s);
+            }
+        }
+    }
+    for (uint64_t ordinal = 0; ordinal < header.document_count; ++ordinal) {
+        for (uint64_t i = contents_.forward_offsets[ordinal]; i < contents_.forward_offsets[ordinal + 1]; ++i) {
+            const TermId term = contents_.forward_term_counts[i].first;
+            if (term >= header.term_count
+                || (i > contents_.forward_offsets[ordinal] && term <= contents_.forward_term_counts[i - 1].first)) {
+                throw std::runtime_error("Corrupted snapshot forward index"s);
+            }
+        }
+    }
+
+    for (uint64_t ordinal = 0; ordinal < header.document_count; ++ordinal) {
+        const int status = static_cast<int>(contents_.document_statuses[ordinal]);
+        if ((ordinal > 0 && contents_.document_ids[ordinal] <= contents_.document_ids[ordinal - 1])
+            || status < 0 || status >= DOCUMENT_STATUS_COUNT) {
+            throw std::runtime_error("Corrupted snapshot documents"s);
+        }
+    }
+    // Bits past the last ordinal would give ordinals of missing documents
+    const size_t bitmap_word_count = OrdinalBitmap::GetWordCount(header.document_count);
+    const uint64_t tail_bits = header.document_count % 64 == 0 ? 0 : ~uint64_t{ 0 } << (header.document_count % 64);
+    for (int status = 0; status < DOCUMENT_STATUS_COUNT && bitmap_word_count > 0; ++status) {
+        if ((contents_.document_status_bitmaps[(status + 1) * bitmap_word_count - 1] & tail_bits) != 0) {
+            throw std::runtime_error("Corrupted snapshot status bitmaps"s);
+        }
+    }
+}
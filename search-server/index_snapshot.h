@@ -0,0 +1,65 @@
+#pragma once
+#include "document.h"
+#include "mapped_array.h"
+#include "ordinal_bitmap.h"
+#include "term_dictionary.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Binary image of a frozen SearchServer. The file is memory-mapped on load and
+// every array in Contents points straight into the mapping, so opening a
+// snapshot costs the same regardless of how many documents it holds.
+// Arrays are stored in native byte order, each section aligned to 8 bytes.
+class IndexSnapshot {
+public:
+    struct Contents {
+        std::vector<std::string_view> stop_words;
+        // Sorted term dictionary, a term's position is its id
+        std::vector<std::string_view> terms;
+        MappedArray<double> log_document_freqs;
+        MappedArray<double> max_term_freqs;
+        MappedArray<uint64_t> posting_offsets;
+        MappedArray<int> posting_ordinals;
+        MappedArray<double> posting_term_freqs;
+        // Per-document columns indexed by ordinal, every ordinal is a live document.
+        // Ordinals follow ascending ids, so an id is found by binary search
+        MappedArray<int> document_ids;
+        MappedArray<int> document_ratings;
+        MappedArray<DocumentStatus> document_statuses;
+        MappedArray<uint32_t> document_word_counts;
+        // DOCUMENT_STATUS_COUNT ordinal bitmaps of OrdinalBitmap::GetWordCount(documents) words each
+        MappedArray<uint64_t> document_status_bitmaps;
+        // Forward index: term ids and occurrence counts of every document
+        MappedArray<uint64_t> forward_offsets;
+        MappedArray<std::pair<TermId, uint32_t>> forward_term_counts;
+        double log_document_count = 0.0;
+    };
+
+    static void Write(const std::string& path, const Contents& contents);
+
+    explicit IndexSnapshot(const std::string& path);
+    ~IndexSnapshot();
+
+    IndexSnapshot(const IndexSnapshot&) = delete;
+    IndexSnapshot& operator=(const IndexSnapshot&) = delete;
+
+    const Contents& GetContents() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+    Contents contents_;
+
+    void Map(const std::string& path);
+    void Unmap();
+    // Also checks every offset, ordinal, term id and status, so that lookups
+    // in the mapped arrays cannot go out of bounds
+    void Parse();
+};
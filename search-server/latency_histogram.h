@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear histogram of durations in nanoseconds, in the manner of HdrHistogram:
+// every power of two is split into SUB_BUCKET_COUNT equal buckets, so a reported
+// percentile is within 1 / SUB_BUCKET_COUNT of the recorded value.
+// One thread records, any thread may read; counters are atomics with relaxed
+// loads and stores only, so recording needs no locked instruction
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{ 1 } << SUB_BUCKET_BITS;
+    // Longer durations are counted as this one, about 18 minutes
+    static constexpr uint64_t MAX_VALUE = (uint64_t{ 1 } << 40) - 1;
+    static constexpr size_t BUCKET_COUNT = (40 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    void Record(std::chrono::nanoseconds duration) {
+        const uint64_t value = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+        auto& count = counts_[GetBucket(value < MAX_VALUE ? value : MAX_VALUE)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Adds the counts of other to this histogram, which must not be recorded to meanwhile
+    void Merge(const LatencyHistogram& other) {
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            const uint64_t count = other.counts_[bucket].load(std::memory_order_relaxed);
+            if (count > 0) {
+                counts_[bucket].store(counts_[bucket].load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Reset() {
+        for (auto& count : counts_) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t GetCount() const {
+        uint64_t total = 0;
+        for (const auto& count : counts_) {
+            total += count.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // The largest duration of the bucket that holds the given fraction of recorded ones
+    std::chrono::nanoseconds GetPercentile(double fraction) const {
+        const uint64_t total = GetCount();
+        if (total == 0) {
+            return std::chrono::nanoseconds::zero();
+        }
+        const auto rank = static_cast<uint64_t>(fraction * total);
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            seen += counts_[bucket].load(std::memory_order_relaxed);
+            if (seen > rank || seen == total) {
+                return std::chrono::nanoseconds(GetBucketMax(bucket));
+            }
+        }
+        return std::chrono::nanoseconds(MAX_VALUE);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts_{};
+
+    static size_t GetBucket(uint64_t value) {
+        if (value < SUB_BUCKET_COUNT) {
+            return static_cast<size_t>(value);
+        }
+        const int shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+        return static_cast<size_t>((shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) - SUB_BUCKET_COUNT));
+    }
+
+    static uint64_t GetBucketMax(size_t bucket) {
+        if (bucket < SUB_BUCKET_COUNT) {
+            return bucket;
+        }
+        const int shift = static_cast<int>(bucket / SUB_BUCKET_COUNT) - 1;
+        const uint64_t first = (SUB_BUCKET_COUNT + bucket % SUB_BUCKET_COUNT) << shift;
+        return first + (uint64_t{ 1 } << shift) - 1;
+    }
+};
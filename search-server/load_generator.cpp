@@ -0,0 +1,76 @@
+#include "load_generator.h"
+#include <algorithm>
+#include <deque>
+#include <thread>
+
+LoadReport RunOpenLoopLoad(AsyncSearchServer& server, const std::vector<std::string>& queries,
+    double target_rate, AsyncSearchServer::Clock::duration duration, AsyncSearchServer::Clock::duration timeout) {
+
+    using Clock = AsyncSearchServer::Clock;
+    using namespace std::chrono;
+
+    struct PendingQuery {
+        Clock::time_point submit_time;
+        std::future<std::vector<Document>> result;
+    };
+
+    LoadReport report;
+    if (queries.empty() || target_rate <= 0.0) {
+        return report;
+    }
+    const auto interval = duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / target_rate));
+    const Clock::time_point start_time = Clock::now();
+    const Clock::time_point end_time = start_time + duration;
+
+    std::vector<Clock::duration> latencies;
+    std::deque<PendingQuery> pending;
+    const auto collect = [&](bool wait) {
+        // Results are polled rather than awaited in order, so one slow query does not
+        // add its latency to the ones submitted after it
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (!wait && it->result.wait_for(Clock::duration::zero()) != std::future_status::ready) {
+                ++it;
+                continue;
+            }
+            it->result.wait();
+            const Clock::time_point finish_time = Clock::now();
+            try {
+                it->result.get();
+                latencies.push_back(finish_time - it->submit_time);
+            }
+            catch (...) {
+                ++report.dropped;
+            }
+            it = pending.erase(it);
+        }
+    };
+
+    Clock::time_point next_time = start_time;
+    while (next_time < end_time) {
+        collect(false);
+        if (Clock::now() < next_time) {
+            std::this_thread::sleep_until(std::min(next_time, Clock::now() + microseconds(100)));
+            continue;
+        }
+        const Clock::time_point submit_time = Clock::now();
+        const Clock::time_point deadline = timeout == Clock::duration::zero()
+            ? Clock::time_point::max()
+            : submit_time + timeout;
+        pending.push_back({ submit_time, server.Submit(queries[report.submitted % queries.size()],
+            DocumentStatus::ACTUAL, deadline).result });
+        ++report.submitted;
+        next_time += interval;
+    }
+    collect(true);
+
+    const double seconds = std::chrono::duration<double>(Clock::now() - start_time).count();
+    report.completed = latencies.size();
+    report.completed_per_second = seconds > 0.0 ? report.completed / seconds : 0.0;
+    std::sort(latencies.begin(), latencies.end());
+    if (!latencies.empty()) {
+        report.median_latency = latencies[latencies.size() / 2];
+        report.p99_latency = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+        report.max_latency = latencies.back();
+    }
+    return report;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "async_search_server.h"
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct LoadReport {
+    size_t submitted = 0;
+    size_t completed = 0;
+    // Rejected, expired or failed queries
+    size_t dropped = 0;
+    double completed_per_second = 0.0;
+    // Latencies of completed queries, from submission to the result
+    AsyncSearchServer::Clock::duration median_latency{};
+    AsyncSearchServer::Clock::duration p99_latency{};
+    AsyncSearchServer::Clock::duration max_latency{};
+};
+
+// Open-loop load: submits queries round-robin at target_rate per second for the given
+// duration, whether or not earlier ones have finished, as independent clients would.
+// Every query gets the same timeout; a zero timeout means no deadline
+LoadReport RunOpenLoopLoad(AsyncSearchServer& server, const std::vector<std::string>& queries,
+    double target_rate, AsyncSearchServer::Clock::duration duration, AsyncSearchServer::Clock::duration timeout);
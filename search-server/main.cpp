@@ -1,5 +1,9 @@
 #include "search_server.h"
+#include "load_generator.h"
 #include "log_duration.h"
+#include "query_profiler.h"
+#include "test_example_functions.h"
+#include <chrono>
 #include <execution>
 #include <iostream>
 #include <random>
@@ -56,16 +60,61 @@ void Test(string_view mark, const SearchServer& search_server, const vector<stri
     }
     cout << total_relevance << endl;
 }
+// Offers twice the load the workers can take, first to a server that queues everything
+// and then to one that sheds what it cannot serve in time
+void TestOverload(const SearchServer& search_server, const vector<string>& queries) {
+    using namespace chrono;
+    const auto start_time = steady_clock::now();
+    SearchServer::QueryContext context;
+    for (const string& query : queries) {
+        search_server.FindTopDocuments(context, query);
+    }
+    const double query_seconds = duration<double>(steady_clock::now() - start_time).count() / queries.size();
+    const size_t worker_count = max(1u, thread::hardware_concurrency());
+    const double capacity = worker_count / query_seconds;
+
+    const auto target_latency = milliseconds(20);
+    const size_t shedding_queue_capacity = max<size_t>(1, static_cast<size_t>(capacity * duration<double>(target_latency).count()));
+    const vector<pair<string, AsyncSearchServer::Options>> setups = {
+        { "unbounded"s, { worker_count, numeric_limits<size_t>::max(), AsyncSearchServer::OverloadPolicy::WAIT } },
+        { "shedding"s, { worker_count, shedding_queue_capacity, AsyncSearchServer::OverloadPolicy::REJECT } },
+    };
+    for (const auto& [name, options] : setups) {
+        AsyncSearchServer server(search_server, options);
+        const auto timeout = options.overload_policy == AsyncSearchServer::OverloadPolicy::REJECT
+            ? duration_cast<steady_clock::duration>(target_latency)
+            : steady_clock::duration::zero();
+        const LoadReport report = RunOpenLoopLoad(server, queries, 2 * capacity, seconds(1), timeout);
+        cout << name << ": "s << report.completed << " of "s << report.submitted << " queries, p50 "s
+            << duration_cast<milliseconds>(report.median_latency).count() << " ms, p99 "s
+            << duration_cast<milliseconds>(report.p99_latency).count() << " ms"s << endl;
+    }
+}
+void PrintQueryProfile() {
+    const auto snapshot = QueryProfiler::GetSnapshot();
+    for (int stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+        const auto& stats = snapshot[stage];
+        cout << QueryProfiler::GetStageName(static_cast<QueryStage>(stage)) << ": "s << stats.count << " times, p50 "s
+            << stats.p50.count() << " ns, p99 "s << stats.p99.count() << " ns, p999 "s << stats.p999.count() << " ns"s << endl;
+    }
+}
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
 int main() {
+    TestSearchServer();
     mt19937 generator;
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
     const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
     SearchServer search_server(dictionary[0]);
+    vector<SearchServer::NewDocument> batch;
+    batch.reserve(documents.size());
     for (size_t i = 0; i < documents.size(); ++i) {
-        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        batch.push_back({ static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 } });
     }
+    search_server.AddDocuments(execution::par, batch);
+    search_server.Freeze();
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
     TEST(seq);
     TEST(par);
+    PrintQueryProfile();
+    TestOverload(search_server, queries);
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Contiguous read-mostly array that either owns its elements or refers to memory
+// owned elsewhere, such as a memory-mapped index snapshot. Appending to a view
+// first copies the viewed elements into owned storage
+template <typename T>
+class MappedArray {
+public:
+    MappedArray() = default;
+
+    explicit MappedArray(std::vector<T> values)
+        : values_(std::move(values))
+        , data_(values_.data())
+        , size_(values_.size())
+    {
+    }
+
+    MappedArray(const T* data, size_t size)
+        : data_(data)
+        , size_(size)
+    {
+    }
+
+    MappedArray(const MappedArray& other) {
+        *this = other;
+    }
+
+    MappedArray(MappedArray&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedArray& operator=(const MappedArray& other) {
+        if (this != &other) {
+            values_ = other.values_;
+            data_ = other.IsOwning() ? values_.data() : other.data_;
+            size_ = other.size_;
+        }
+        return *this;
+    }
+
+    MappedArray& operator=(MappedArray&& other) noexcept {
+        if (this != &other) {
+            const bool is_owning = other.IsOwning();
+            values_ = std::move(other.values_);
+            data_ = is_owning ? values_.data() : other.data_;
+            size_ = other.size_;
+            other.values_.clear();
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    bool IsOwning() const {
+        return data_ == values_.data();
+    }
+
+    void MakeOwning() {
+        if (!IsOwning()) {
+            values_.assign(data_, data_ + size_);
+            data_ = values_.data();
+        }
+    }
+
+    void push_back(const T& value) {
+        MakeOwning();
+        values_.push_back(value);
+        data_ = values_.data();
+        ++size_;
+    }
+
+    // Appended elements are value-initialized
+    void resize(size_t size) {
+        MakeOwning();
+        values_.resize(size);
+        data_ = values_.data();
+        size_ = size;
+    }
+
+    // Writable element; a view is copied into owned storage first
+    T& GetMutable(size_t index) {
+        MakeOwning();
+        return values_[index];
+    }
+
+    const T& operator[](size_t index) const {
+        return data_[index];
+    }
+
+    const T* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    const T* begin() const {
+        return data_;
+    }
+
+    const T* end() const {
+        return data_ + size_;
+    }
+
+private:
+    std::vector<T> values_;
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+};
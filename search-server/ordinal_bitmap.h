@@ -0,0 +1,56 @@
+#pragma once
+#include "mapped_array.h"
+#include <cstddef>
+#include <cstdint>
+
+// Set of document ordinals as one bit per ordinal. Dense ordinals make a plain
+// bitmap as compact as a compressed one, and 64 documents are tested per word
+class OrdinalBitmap {
+public:
+    OrdinalBitmap() = default;
+
+    explicit OrdinalBitmap(MappedArray<uint64_t> words)
+        : words_(std::move(words))
+    {
+    }
+
+    static size_t GetWordCount(size_t ordinal_count) {
+        return (ordinal_count + 63) / 64;
+    }
+
+    bool Contains(int ordinal) const {
+        const size_t word = static_cast<size_t>(ordinal) / 64;
+        return word < words_.size() && ((words_[word] >> (ordinal % 64)) & 1);
+    }
+
+    // Bit i of the result tells whether first_ordinal + i is in the set
+    uint64_t GetBits(int first_ordinal) const {
+        const size_t word = static_cast<size_t>(first_ordinal) / 64;
+        const int shift = first_ordinal % 64;
+        const uint64_t low = word < words_.size() ? words_[word] >> shift : 0;
+        const uint64_t high = shift > 0 && word + 1 < words_.size() ? words_[word + 1] << (64 - shift) : 0;
+        return low | high;
+    }
+
+    void Insert(int ordinal) {
+        const size_t word = static_cast<size_t>(ordinal) / 64;
+        if (word >= words_.size()) {
+            words_.resize(word + 1);
+        }
+        words_.GetMutable(word) |= uint64_t{ 1 } << (ordinal % 64);
+    }
+
+    void Erase(int ordinal) {
+        const size_t word = static_cast<size_t>(ordinal) / 64;
+        if (word < words_.size()) {
+            words_.GetMutable(word) &= ~(uint64_t{ 1 } << (ordinal % 64));
+        }
+    }
+
+    const MappedArray<uint64_t>& GetWords() const {
+        return words_;
+    }
+
+private:
+    MappedArray<uint64_t> words_;
+};
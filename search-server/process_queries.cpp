@@ -2,6 +2,11 @@
 #include <execution>
 #include "log_duration.h"
 #include <numeric>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <mutex>
 
 
 std::vector<std::vector<Document>> ProcessQueries(
@@ -15,30 +20,108 @@ std::vector<std::vector<Document>> ProcessQueries(
     std::vector<std::vector<Document>> result(queries.size());
 
     std::transform(std::execution::par, queries.begin(), queries.end(), result.begin(), [&search_server](const std::string& s) noexcept {
-        return search_server.FindTopDocuments(s);
+        // Every worker thread keeps its scratch buffers between queries
+        thread_local SearchServer::QueryContext context;
+        return search_server.FindTopDocuments(context, s);
     });
 
     return result;
 }
 
 
-std::list<Document> ProcessQueriesJoined(
+JoinedQueryResults ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
 
-    const auto top_documents = ProcessQueries(search_server, queries);
-
-    std::list<Document> result;
-
-    for (const auto a : top_documents) {
-
-        std::list<Document> temp(a.size());
+    JoinedQueryResults result;
+    result.offsets.assign(queries.size() + 1, 0);
+    if (queries.empty()) {
+        return result;
+    }
 
-        std::transform(std::execution::par, a.begin(), a.end(), temp.begin(), [](const Document doc) { return doc;});
+    // Every query writes to its own fixed-size slot, the slots are then closed up in place
+    result.documents.resize(queries.size() * MAX_RESULT_DOCUMENT_COUNT);
+    // Parallel algorithms terminate on an escaping exception, so errors are kept per query
+    std::vector<std::exception_ptr> errors(queries.size());
+    std::vector<size_t> indexes(queries.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t i) noexcept {
+        thread_local SearchServer::QueryContext context;
+        try {
+            const auto& documents = search_server.FindTopDocuments(context, queries[i]);
+            std::copy(documents.begin(), documents.end(), result.documents.begin() + i * MAX_RESULT_DOCUMENT_COUNT);
+            result.offsets[i + 1] = documents.size();
+        }
+        catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
 
-        result.insert(result.end(), temp.begin(), temp.end()); 
+    std::partial_sum(result.offsets.begin(), result.offsets.end(), result.offsets.begin());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto slot = result.documents.begin() + i * MAX_RESULT_DOCUMENT_COUNT;
+        std::copy(slot, slot + (result.offsets[i + 1] - result.offsets[i]), result.documents.begin() + result.offsets[i]);
     }
+    result.documents.resize(result.offsets.back());
 
     return result;
+}
+
+void ProcessQueriesStreaming(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    const std::function<void(size_t, const std::vector<Document>&)>& consumer) {
+
+    std::vector<std::vector<Document>> results(queries.size());
+    std::vector<std::exception_ptr> errors(queries.size());
+    std::vector<char> is_ready(queries.size(), false);
+    std::mutex ready_mutex;
+    std::condition_variable ready_condition;
+    std::atomic<bool> is_cancelled = false;
+
+    auto producer = std::async(std::launch::async, [&] {
+        std::vector<size_t> indexes(queries.size());
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t i) noexcept {
+            if (!is_cancelled) {
+                thread_local SearchServer::QueryContext context;
+                try {
+                    results[i] = search_server.FindTopDocuments(context, queries[i]);
+                }
+                catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+            {
+                std::lock_guard ready_lock(ready_mutex);
+                is_ready[i] = true;
+            }
+            ready_condition.notify_all();
+        });
+    });
 
-}
\ No newline at end of file
+    try {
+        for (size_t i = 0; i < queries.size(); ++i) {
+            {
+                std::unique_lock ready_lock(ready_mutex);
+                ready_condition.wait(ready_lock, [&] { return is_ready[i] != 0; });
+            }
+            if (errors[i]) {
+                std::rethrow_exception(errors[i]);
+            }
+            consumer(i, results[i]);
+            results[i] = {};
+        }
+    }
+    catch (...) {
+        // Workers refer to the local state, so they have to finish first
+        is_cancelled = true;
+        producer.wait();
+        throw;
+    }
+}
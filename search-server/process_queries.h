@@ -3,12 +3,39 @@
 #include <vector>
 #include "document.h"
 #include "search_server.h"
-#include <list>
+#include <functional>
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
-std::list<Document> ProcessQueriesJoined(
+// Results of all queries in one buffer: those of query i are
+// documents[offsets[i]] .. documents[offsets[i + 1]]
+struct JoinedQueryResults {
+    std::vector<Document> documents;
+    std::vector<size_t> offsets;
+
+    std::vector<Document>::const_iterator begin() const {
+        return documents.begin();
+    }
+    std::vector<Document>::const_iterator end() const {
+        return documents.end();
+    }
+    size_t size() const {
+        return documents.size();
+    }
+};
+
+// Throws the error of the first invalid query after all queries have run
+JoinedQueryResults ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Calls consumer(query_index, documents) on the calling thread in the order of the
+// queries, as soon as each query is done; later queries are processed meanwhile.
+// An invalid query is reported by throwing when its turn comes, and if the consumer
+// throws, the remaining queries are skipped
+void ProcessQueriesStreaming(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries,
+    const std::function<void(size_t, const std::vector<Document>&)>& consumer);
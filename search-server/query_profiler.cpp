@@ -0,0 +1,108 @@
+#include "query_profiler.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+using StageHistograms = std::array<LatencyHistogram, QUERY_STAGE_COUNT>;
+
+// Histograms of threads that have exited are handed to new threads, so their
+// counts stay in snapshots and short-lived threads do not pile up memory
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<StageHistograms>> histograms;
+    std::vector<StageHistograms*> free_histograms;
+};
+
+Registry& GetRegistry() {
+    // Never destroyed: threads may record while static objects are being destroyed
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+class ThreadHistograms {
+public:
+    ThreadHistograms() {
+        Registry& registry = GetRegistry();
+        std::lock_guard registry_lock(registry.mutex);
+        if (registry.free_histograms.empty()) {
+            histograms_ = registry.histograms.emplace_back(std::make_unique<StageHistograms>()).get();
+        }
+        else {
+            histograms_ = registry.free_histograms.back();
+            registry.free_histograms.pop_back();
+        }
+    }
+
+    ~ThreadHistograms() {
+        Registry& registry = GetRegistry();
+        std::lock_guard registry_lock(registry.mutex);
+        registry.free_histograms.push_back(histograms_);
+    }
+
+    StageHistograms& Get() {
+        return *histograms_;
+    }
+
+private:
+    StageHistograms* histograms_ = nullptr;
+};
+
+}
+
+void QueryProfiler::Record(QueryStage stage, std::chrono::nanoseconds duration) {
+    thread_local ThreadHistograms histograms;
+    histograms.Get()[static_cast<int>(stage)].Record(duration);
+}
+
+QueryProfiler::Snapshot QueryProfiler::GetSnapshot() {
+
+    auto merged = std::make_unique<StageHistograms>();
+    {
+        Registry& registry = GetRegistry();
+        std::lock_guard registry_lock(registry.mutex);
+        for (const auto& histograms : registry.histograms) {
+            for (int stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+                (*merged)[stage].Merge((*histograms)[stage]);
+            }
+        }
+    }
+
+    Snapshot snapshot;
+    for (int stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+        const LatencyHistogram& histogram = (*merged)[stage];
+        snapshot[stage].count = histogram.GetCount();
+        snapshot[stage].p50 = histogram.GetPercentile(0.5);
+        snapshot[stage].p99 = histogram.GetPercentile(0.99);
+        snapshot[stage].p999 = histogram.GetPercentile(0.999);
+        snapshot[stage].max = histogram.GetPercentile(1.0);
+    }
+    return snapshot;
+}
+
+void QueryProfiler::Reset() {
+    Registry& registry = GetRegistry();
+    std::lock_guard registry_lock(registry.mutex);
+    for (const auto& histograms : registry.histograms) {
+        for (LatencyHistogram& histogram : *histograms) {
+            histogram.Reset();
+        }
+    }
+}
+
+const char* QueryProfiler::GetStageName(QueryStage stage) {
+    switch (stage) {
+    case QueryStage::PARSE:
+        return "parse";
+    case QueryStage::POSTINGS:
+        return "postings";
+    case QueryStage::MINUS_FILTER:
+        return "minus filter";
+    case QueryStage::RANKING:
+        return "ranking";
+    case QueryStage::RESULT_BUILD:
+        return "result build";
+    }
+    return "unknown";
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "latency_histogram.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+// Stages of a query that the search server times
+enum class QueryStage {
+    PARSE,
+    POSTINGS,
+    MINUS_FILTER,
+    RANKING,
+    RESULT_BUILD,
+};
+
+const int QUERY_STAGE_COUNT = 5;
+
+// Process-wide latency histograms of query stages. Every thread records into its
+// own histograms, created on its first record, and a snapshot merges all of them.
+// Building with SEARCH_SERVER_NO_PROFILING removes the timers from the search code
+class QueryProfiler {
+public:
+    struct StageStats {
+        uint64_t count = 0;
+        std::chrono::nanoseconds p50{};
+        std::chrono::nanoseconds p99{};
+        std::chrono::nanoseconds p999{};
+        std::chrono::nanoseconds max{};
+    };
+
+    using Snapshot = std::array<StageStats, QUERY_STAGE_COUNT>;
+
+    static void Record(QueryStage stage, std::chrono::nanoseconds duration);
+    static Snapshot GetSnapshot();
+    // Counts recorded concurrently with the reset may survive it
+    static void Reset();
+
+    static const char* GetStageName(QueryStage stage);
+};
+
+// Records the time from its construction to its destruction
+class QueryStageTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit QueryStageTimer(QueryStage stage)
+        : stage_(stage)
+    {
+    }
+
+    QueryStageTimer(const QueryStageTimer&) = delete;
+    QueryStageTimer& operator=(const QueryStageTimer&) = delete;
+
+    ~QueryStageTimer() {
+        QueryProfiler::Record(stage_, Clock::now() - start_time_);
+    }
+
+private:
+    const QueryStage stage_;
+    const Clock::time_point start_time_ = Clock::now();
+};
+
+#define QUERY_PROFILER_CONCAT_INTERNAL(X, Y) X##Y
+#define QUERY_PROFILER_CONCAT(X, Y) QUERY_PROFILER_CONCAT_INTERNAL(X, Y)
+
+#ifdef SEARCH_SERVER_NO_PROFILING
+#define PROFILE_QUERY_STAGE(stage)
+#else
+#define PROFILE_QUERY_STAGE(stage) QueryStageTimer QUERY_PROFILER_CONCAT(queryStageTimer, __LINE__)(stage)
+#endif
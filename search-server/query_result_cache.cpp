@@ -0,0 +1,111 @@
+#include "query_result_cache.h"
+
+bool QueryResultCache::Key::operator==(const Key& other) const {
+    return filter.status == other.filter.status
+        && filter.min_rating == other.filter.min_rating
+        && filter.max_rating == other.filter.max_rating
+        && top_count == other.top_count
+        && plus_terms == other.plus_terms
+        && minus_terms == other.minus_terms;
+}
+
+size_t QueryResultCache::KeyHash::operator()(const Key& key) const {
+    uint64_t hash = static_cast<uint64_t>(key.filter.status) * 31 + key.top_count;
+    const auto mix = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    };
+    mix(static_cast<uint32_t>(key.filter.min_rating));
+    mix(static_cast<uint32_t>(key.filter.max_rating));
+    for (const TermId term : key.plus_terms) {
+        mix(term);
+    }
+    // Keeps {a} + {-b} apart from {a, b}
+    mix(key.plus_terms.size());
+    for (const TermId term : key.minus_terms) {
+        mix(term);
+    }
+    return static_cast<size_t>(hash);
+}
+
+double QueryResultCache::Stats::GetHitRate() const {
+    const uint64_t lookups = hits + misses;
+    return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+}
+
+QueryResultCache::QueryResultCache(size_t capacity)
+    : capacity_(capacity)
+{
+}
+
+bool QueryResultCache::Find(const Key& key, uint64_t index_version, std::vector<Document>& result) {
+    std::lock_guard guard(mutex_);
+
+    const auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++stats_.misses;
+        return false;
+    }
+    if (it->second->index_version != index_version) {
+        Erase(it->second);
+        ++stats_.misses;
+        return false;
+    }
+
+    entries_.splice(entries_.begin(), entries_, it->second);
+    result.assign(it->second->documents.begin(), it->second->documents.end());
+    ++stats_.hits;
+    return true;
+}
+
+void QueryResultCache::Insert(Key key, uint64_t index_version, const std::vector<Document>& documents) {
+    if (capacity_ == 0) {
+        return;
+    }
+    std::lock_guard guard(mutex_);
+
+    // Another thread may have computed the same query meanwhile
+    const auto it = index_.find(key);
+    if (it != index_.end()) {
+        Erase(it->second);
+    }
+    while (entries_.size() >= capacity_) {
+        Erase(std::prev(entries_.end()));
+    }
+
+    entries_.push_front({ std::move(key), index_version, documents });
+    index_.emplace(entries_.front().key, entries_.begin());
+    stats_.memory_bytes += GetEntryMemory(entries_.front());
+    stats_.entry_count = entries_.size();
+}
+
+QueryResultCache::Stats QueryResultCache::GetStats() const {
+    std::lock_guard guard(mutex_);
+    return stats_;
+}
+
+size_t QueryResultCache::GetCapacity() const {
+    return capacity_;
+}
+
+void QueryResultCache::Clear() {
+    std::lock_guard guard(mutex_);
+    index_.clear();
+    entries_.clear();
+    stats_.entry_count = 0;
+    stats_.memory_bytes = 0;
+}
+
+size_t QueryResultCache::GetEntryMemory(const Entry& entry) {
+    // The entry is stored in a list node and its key once more in a hash map node
+    return 2 * sizeof(Entry) + 4 * sizeof(void*)
+        + 2 * sizeof(TermId) * (entry.key.plus_terms.capacity() + entry.key.minus_terms.capacity())
+        + sizeof(Document) * entry.documents.capacity();
+}
+
+void QueryResultCache::Erase(EntryList::iterator entry) {
+    stats_.memory_bytes -= GetEntryMemory(*entry);
+    index_.erase(entry->key);
+    entries_.erase(entry);
+    stats_.entry_count = entries_.size();
+}
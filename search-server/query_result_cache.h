@@ -0,0 +1,72 @@
+#pragma once
+#include "document.h"
+#include "term_dictionary.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Bounded LRU cache of top documents for filter queries, shared by all threads.
+// Every entry remembers the index version it was computed for, so a change of
+// the index invalidates all entries without touching them
+class QueryResultCache {
+public:
+    // Normalized query: sorted unique term ids as ParseQuery produces them
+    struct Key {
+        std::vector<TermId> plus_terms;
+        std::vector<TermId> minus_terms;
+        DocumentFilter filter;
+        size_t top_count = 0;
+
+        bool operator==(const Key& other) const;
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t entry_count = 0;
+        // Approximate heap memory held by the entries
+        size_t memory_bytes = 0;
+
+        double GetHitRate() const;
+    };
+
+    explicit QueryResultCache(size_t capacity);
+
+    // Copies cached documents to result; entries of other index versions count as misses
+    bool Find(const Key& key, uint64_t index_version, std::vector<Document>& result);
+
+    void Insert(Key key, uint64_t index_version, const std::vector<Document>& documents);
+
+    Stats GetStats() const;
+
+    size_t GetCapacity() const;
+
+    void Clear();
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        Key key;
+        uint64_t index_version = 0;
+        std::vector<Document> documents;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    // Most recently used first
+    EntryList entries_;
+    std::unordered_map<Key, EntryList::iterator, KeyHash> index_;
+    Stats stats_;
+
+    static size_t GetEntryMemory(const Entry& entry);
+    void Erase(EntryList::iterator entry);
+};
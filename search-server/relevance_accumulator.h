@@ -0,0 +1,99 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Dense relevance accumulator indexed by document ordinal. Ordinals are split
+// into contiguous shards and every shard keeps its own list of touched ordinals,
+// so threads working on different shards never write to shared state.
+class RelevanceAccumulator {
+public:
+    RelevanceAccumulator() = default;
+
+    // Prepares the accumulator for a new query; only previously touched slots are cleared.
+    // Without has_slots only the shard ranges are set up, for scoring that keeps its own
+    // state, and the slots are released. They are also released when they are much larger
+    // than the index, so a long-lived context does not hold on to the size of a past one
+    void Reset(size_t ordinal_count, size_t shard_count, bool has_slots = true) {
+        if (!has_slots || relevances_.size() > 2 * ordinal_count) {
+            relevances_ = {};
+            states_ = {};
+        }
+        else {
+            for (const auto& touched : touched_) {
+                for (const int ordinal : touched) {
+                    relevances_[ordinal] = 0.0;
+                    states_[ordinal] = State::UNTOUCHED;
+                }
+            }
+        }
+        if (has_slots && relevances_.size() < ordinal_count) {
+            relevances_.resize(ordinal_count, 0.0);
+            states_.resize(ordinal_count, State::UNTOUCHED);
+        }
+        ordinal_count_ = ordinal_count;
+        shard_count = std::max<size_t>(1, std::min(shard_count, ordinal_count));
+        shard_size_ = (ordinal_count + shard_count - 1) / shard_count;
+        touched_.resize(shard_count);
+        for (auto& touched : touched_) {
+            touched.clear();
+        }
+    }
+
+    size_t GetShardCount() const {
+        return touched_.size();
+    }
+
+    int GetShardBegin(size_t shard) const {
+        return static_cast<int>(std::min(ordinal_count_, shard * shard_size_));
+    }
+
+    int GetShardEnd(size_t shard) const {
+        return static_cast<int>(std::min(ordinal_count_, (shard + 1) * shard_size_));
+    }
+
+    void Add(size_t shard, int ordinal, double relevance) {
+        if (states_[ordinal] == State::EXCLUDED) {
+            return;
+        }
+        if (states_[ordinal] == State::UNTOUCHED) {
+            states_[ordinal] = State::MATCHED;
+            touched_[shard].push_back(ordinal);
+        }
+        relevances_[ordinal] += relevance;
+    }
+
+    bool IsExcluded(int ordinal) const {
+        return states_[ordinal] == State::EXCLUDED;
+    }
+
+    void Exclude(size_t shard, int ordinal) {
+        if (states_[ordinal] == State::UNTOUCHED) {
+            touched_[shard].push_back(ordinal);
+        }
+        states_[ordinal] = State::EXCLUDED;
+    }
+
+    // Calls function(ordinal, relevance) for every matched ordinal of the shard
+    template <typename Function>
+    void ForEachMatched(size_t shard, Function function) const {
+        for (const int ordinal : touched_[shard]) {
+            if (states_[ordinal] == State::MATCHED) {
+                function(ordinal, relevances_[ordinal]);
+            }
+        }
+    }
+
+private:
+    enum class State : char {
+        UNTOUCHED,
+        MATCHED,
+        EXCLUDED,
+    };
+
+    std::vector<double> relevances_;
+    std::vector<State> states_;
+    std::vector<std::vector<int>> touched_;
+    size_t ordinal_count_ = 0;
+    size_t shard_size_ = 0;
+};
@@ -3,14 +3,16 @@
 
 void RemoveDuplicates(SearchServer& search_server) {
 
-    std::map<std::set<std::string_view>, int> words_docs;
+    // Term counts are sorted by term id, so equal word sets give equal id vectors
+    std::map<std::vector<TermId>, int> words_docs;
     std::set<int> ids_to_del;
 
     for (const int id : search_server) {
-        const auto temp = search_server.GetWordFrequencies(id);
-        std::set<std::string_view> set_to_push;
+        const auto& temp = search_server.GetTermCounts(id);
+        std::vector<TermId> set_to_push;
+        set_to_push.reserve(temp.size());
         for (const auto& words : temp) {
-            set_to_push.insert(words.first);
+            set_to_push.push_back(words.first);
         }
         if (words_docs.count(set_to_push)) {
             ids_to_del.insert(id);
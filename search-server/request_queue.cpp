@@ -1,5 +1,23 @@
 #include "request_queue.h"
+#include <algorithm>
 
+namespace {
+
+// Bit 31 marks a used slot, bits 24-30 hold the result count and bits 0-23 the latency
+// in microseconds; both are saturated
+const uint32_t USED_BIT = uint32_t{ 1 } << 31;
+const int RESULT_COUNT_SHIFT = 24;
+const uint32_t MAX_RESULT_COUNT = 0x7F;
+const uint32_t MAX_LATENCY = 0xFFFFFF;
+
+uint32_t PackRequest(size_t result_count, std::chrono::microseconds latency) {
+    const auto latency_count = static_cast<uint64_t>(std::max<std::chrono::microseconds::rep>(0, latency.count()));
+    return USED_BIT
+        | static_cast<uint32_t>(std::min<size_t>(result_count, MAX_RESULT_COUNT)) << RESULT_COUNT_SHIFT
+        | static_cast<uint32_t>(std::min<uint64_t>(latency_count, MAX_LATENCY));
+}
+
+}
 
 RequestQueue::RequestQueue(const SearchServer& search_server)
     :search_server_(search_server)
@@ -7,35 +25,57 @@ RequestQueue::RequestQueue(const SearchServer& search_server)
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
+    const auto start_time = Clock::now();
     const std::vector<Document> result = search_server_.FindTopDocuments(raw_query, status);
-    AddResut(result);
+    AddResult(result.size(), Clock::now() - start_time);
     return result;
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
-    const std::vector<Document> result = search_server_.FindTopDocuments(raw_query);
-    AddResut(result);
-    return result;
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
 
 int RequestQueue::GetNoResultRequests() const {
-    return no_result_num_;
+    return no_result_requests_.load(std::memory_order_relaxed);
 }
 
-void RequestQueue::AddResut(const std::vector<Document> content) {
+RequestQueue::WindowStats RequestQueue::GetWindowStats() const {
 
-    ++time_in_general_;
-
-    if (!requests_.empty()) {
-        while (min_in_day_ <= time_in_general_ - requests_.front().add_time) {
-            --no_result_num_;
-            requests_.pop_front();
+    WindowStats stats;
+    std::vector<std::chrono::microseconds> latencies;
+    latencies.reserve(requests_.size());
+    for (const auto& slot : requests_) {
+        const uint32_t request = slot.load(std::memory_order_relaxed);
+        if ((request & USED_BIT) == 0) {
+            continue;
+        }
+        const int result_count = static_cast<int>((request >> RESULT_COUNT_SHIFT) & MAX_RESULT_COUNT);
+        ++stats.request_count;
+        if (result_count == 0) {
+            ++stats.no_result_requests;
         }
+        ++stats.result_count_histogram[std::min(result_count, MAX_RESULT_COUNT_BUCKET)];
+        latencies.emplace_back(request & MAX_LATENCY);
     }
 
-    requests_.push_back({ time_in_general_, content });
-    if (content.empty()) {
-        ++no_result_num_;
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        stats.median_latency = latencies[latencies.size() / 2];
+        stats.p99_latency = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+        stats.max_latency = latencies.back();
     }
+    return stats;
+}
 
-}
\ No newline at end of file
+void RequestQueue::AddResult(size_t result_count, Clock::duration latency) {
+    // The request that is min_in_day_ older leaves the window as this one takes its slot
+    const uint64_t request_index = request_count_.fetch_add(1, std::memory_order_relaxed);
+    const uint32_t old_request = requests_[request_index % min_in_day_].exchange(
+        PackRequest(result_count, std::chrono::duration_cast<std::chrono::microseconds>(latency)),
+        std::memory_order_relaxed);
+    const bool was_empty = (old_request & USED_BIT) != 0 && ((old_request >> RESULT_COUNT_SHIFT) & MAX_RESULT_COUNT) == 0;
+    const bool is_empty = result_count == 0;
+    if (was_empty != is_empty) {
+        no_result_requests_.fetch_add(is_empty ? 1 : -1, std::memory_order_relaxed);
+    }
+}
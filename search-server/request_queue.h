@@ -1,11 +1,19 @@
 #pragma once
 #include "search_server.h"
 #include "document.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <string>
-#include <deque>
 #include <vector>
 
 
+// Runs search requests and keeps statistics of the last min_in_day_ of them.
+// Every request leaves one packed word in a ring buffer, so recording costs an
+// atomic increment and an exchange and requests may come from many threads at once.
+// The number of empty results is kept up to date as slots are overwritten, other
+// statistics are gathered from the ring when they are asked for
 class RequestQueue {
 public:
     explicit RequestQueue(const SearchServer& search_server);
@@ -19,24 +27,38 @@ public:
 
     int GetNoResultRequests() const;
 
-private:
-    int time_in_general_ = 0;
-    struct QueryResult {
-        int add_time;
-        std::vector<Document> content;
+    // Result counts of MAX_RESULT_COUNT_BUCKET and more share the last bucket
+    static constexpr int MAX_RESULT_COUNT_BUCKET = MAX_RESULT_DOCUMENT_COUNT;
+
+    struct WindowStats {
+        int request_count = 0;
+        int no_result_requests = 0;
+        std::array<int, MAX_RESULT_COUNT_BUCKET + 1> result_count_histogram{};
+        std::chrono::microseconds median_latency{};
+        std::chrono::microseconds p99_latency{};
+        std::chrono::microseconds max_latency{};
     };
-    std::deque<QueryResult> requests_;
+
+    WindowStats GetWindowStats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
     const static int min_in_day_ = 1440;
     const SearchServer& search_server_;
-    int no_result_num_ = 0;
+    std::atomic<uint64_t> request_count_ = 0;
+    // Zero marks a slot no request has used yet; see PackRequest for the layout
+    std::array<std::atomic<uint32_t>, min_in_day_> requests_{};
+    std::atomic<int> no_result_requests_ = 0;
 
-    void AddResut(const std::vector<Document> content);
+    void AddResult(size_t result_count, Clock::duration latency);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+    const auto start_time = Clock::now();
     const std::vector<Document> result = search_server_.FindTopDocuments(raw_query, document_predicate);
-    AddResut(result);
+    AddResult(result.size(), Clock::now() - start_time);
     return result;
 
-}
\ No newline at end of file
+}
@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <set>
 #include <stdexcept>
@@ -23,71 +24,239 @@ SearchServer::SearchServer(std::string_view stop_words_text)
 {
 }
 
+SearchServer::SearchServer(const SearchServer& other)
+    : stop_words_(other.stop_words_)
+    , dictionary_(other.dictionary_)
+    , term_postings_(other.term_postings_)
+    , log_document_count_(other.log_document_count_)
+    , documents_(other.documents_)
+    , id_to_ordinal_(other.id_to_ordinal_)
+    , document_ids_(other.document_ids_)
+    , frozen_index_(other.frozen_index_)
+    , has_delta_segment_(other.has_delta_segment_)
+    , main_ordinal_count_(other.main_ordinal_count_)
+    , tombstones_(other.tombstones_)
+    , main_document_freqs_(other.main_document_freqs_)
+    , ordinal_generation_(other.ordinal_generation_)
+    , snapshot_(other.snapshot_)
+    , is_snapshot_view_(other.is_snapshot_view_)
+    , index_version_(other.index_version_)
+    , result_cache_(other.result_cache_ ? std::make_unique<QueryResultCache>(other.result_cache_->GetCapacity()) : nullptr)
+    , collection_statistics_(other.collection_statistics_)
+{
+}
+
 void SearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status,
     const std::vector<int>& ratings) {
 
     using namespace std;
 
-    if ((document_id < 0) || (documents_.find(document_id) != documents_.end())) {
+    if ((document_id < 0) || (FindOrdinal(document_id) >= 0)) {
         throw invalid_argument("Invalid document_id"s);
     }
 
-    documents_strings_.push_back(static_cast<std::string>((document)));
+    vector<string_view> words;
+    SplitIntoWordsNoStop(document, words);
 
-    const auto words = SplitIntoWordsNoStop(documents_strings_.back());
+    OpenDeltaSegment();
 
-    const double inv_word_count = 1.0 / words.size();
-    for (const string_view& word : words) {
-        word_to_id_freqs_[word][document_id] += inv_word_count;
-        id_to_words_freq_[document_id][word] += inv_word_count;
+    vector<TermId> terms;
+    terms.reserve(words.size());
+    for (const string_view word : words) {
+        terms.push_back(FindOrAddTerm(word));
+    }
+    sort(terms.begin(), terms.end());
 
+    const int ordinal = static_cast<int>(documents_.ids.size());
+    auto& term_counts = documents_.term_counts.emplace_back();
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (i == 0 || terms[i] != terms[i - 1]) {
+            term_counts.emplace_back(terms[i], 0);
+        }
+        ++term_counts.back().second;
+    }
+    const double inv_word_count = 1.0 / words.size();
+    for (const auto& [term, count] : term_counts) {
+        auto& postings = term_postings_[term];
+        postings.ordinal_freqs.emplace_hint(postings.ordinal_freqs.end(), ordinal, ComputeTermFreq(count, inv_word_count));
+        UpdateLogDocumentFreq(term);
     }
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
+    documents_.ids.push_back(document_id);
+    documents_.word_counts.push_back(static_cast<uint32_t>(words.size()));
+    documents_.ratings.push_back(ComputeAverageRating(ratings));
+    documents_.statuses.push_back(status);
+    documents_.status_ordinals[static_cast<int>(status)].Insert(ordinal);
+    id_to_ordinal_.emplace(document_id, ordinal);
     document_ids_.insert(document_id);
+    UpdateLogDocumentCount();
+    ++index_version_;
+}
+
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    AddDocuments(std::execution::seq, documents);
+}
+
+void SearchServer::BeginDocumentBatch(const std::vector<NewDocument>& documents) {
+
+    using namespace std;
+
+    set<int> batch_ids;
+    for (const NewDocument& document : documents) {
+        if ((document.id < 0) || (FindOrdinal(document.id) >= 0) || !batch_ids.insert(document.id).second) {
+            throw invalid_argument("Invalid document_id"s);
+        }
+    }
+}
+
+void SearchServer::TokenizeDocumentBatch(const std::vector<NewDocument>& documents, size_t first_document,
+    size_t last_document, DocumentBatchChunk& chunk) const {
+
+    using namespace std;
+
+    const int first_ordinal = static_cast<int>(documents_.ids.size());
+
+    try {
+        vector<string_view> words;
+        for (size_t i = first_document; i < last_document; ++i) {
+            SplitIntoWordsNoStop(documents[i].text, words);
+            const int ordinal = first_ordinal + static_cast<int>(i);
+            map<string_view, uint32_t> word_counts;
+            for (const string_view word : words) {
+                ++word_counts[word];
+            }
+            for (const auto& [word, count] : word_counts) {
+                chunk.postings[word].emplace_back(ordinal, count);
+            }
+            chunk.word_counts.push_back(static_cast<uint32_t>(words.size()));
+        }
+    }
+    catch (...) {
+        chunk.error = current_exception();
+    }
+}
+
+void SearchServer::FinishDocumentBatch(const std::vector<NewDocument>& documents, std::vector<DocumentBatchChunk>& chunks) {
+
+    for (const DocumentBatchChunk& chunk : chunks) {
+        if (chunk.error) {
+            std::rethrow_exception(chunk.error);
+        }
+    }
+
+    // Only a batch that is added changes the layout of the index, as in AddDocument
+    OpenDeltaSegment();
+
+    // Chunks cover consecutive ordinals, so every posting is appended at the end of its list
+    const size_t first_ordinal = documents_.ids.size();
+    documents_.term_counts.resize(first_ordinal + documents.size());
+    for (const DocumentBatchChunk& chunk : chunks) {
+        for (const uint32_t word_count : chunk.word_counts) {
+            documents_.word_counts.push_back(word_count);
+        }
+    }
+    for (DocumentBatchChunk& chunk : chunks) {
+        for (const auto& [word, ordinal_counts] : chunk.postings) {
+            const TermId term = FindOrAddTerm(word);
+            auto& postings = term_postings_[term];
+            for (const auto& [ordinal, count] : ordinal_counts) {
+                const double term_freq = ComputeTermFreq(count, 1.0 / documents_.word_counts[ordinal]);
+                postings.ordinal_freqs.emplace_hint(postings.ordinal_freqs.end(), ordinal, term_freq);
+                documents_.term_counts[ordinal].emplace_back(term, count);
+            }
+            UpdateLogDocumentFreq(term);
+        }
+        chunk.postings.clear();
+    }
+    for (size_t ordinal = first_ordinal; ordinal < documents_.term_counts.size(); ++ordinal) {
+        std::sort(documents_.term_counts[ordinal].begin(), documents_.term_counts[ordinal].end());
+    }
+
+    for (const NewDocument& document : documents) {
+        documents_.status_ordinals[static_cast<int>(document.status)].Insert(static_cast<int>(documents_.ids.size()));
+        id_to_ordinal_.emplace(document.id, static_cast<int>(documents_.ids.size()));
+        document_ids_.insert(document.id);
+        documents_.ids.push_back(document.id);
+        documents_.ratings.push_back(ComputeAverageRating(document.ratings));
+        documents_.statuses.push_back(document.status);
+    }
+    UpdateLogDocumentCount();
+    ++index_version_;
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(
-        raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+    return FindTopDocuments(std::execution::seq, raw_query, status);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
+const std::vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, const std::string_view raw_query,
+    DocumentStatus status) const {
+    return FindTopDocumentsWithFilter(std::execution::seq, context, raw_query, DocumentFilter{ status },
+        MAX_RESULT_DOCUMENT_COUNT);
+}
+
+const std::vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, const std::string_view raw_query) const {
+    return FindTopDocuments(context, raw_query, DocumentStatus::ACTUAL);
+}
+
 
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
+std::map<std::string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
 
-    static const std::map<std::string_view, double> empty_map;
+    std::map<std::string_view, double> word_freqs;
+    const int ordinal = FindOrdinal(document_id);
+    if (ordinal < 0) {
+        return word_freqs;
+    }
 
-    if (!id_to_words_freq_.count(document_id)) {
-        return empty_map;
+    const double inv_word_count = 1.0 / documents_.word_counts[ordinal];
+    for (const auto& [term, count] : GetDocumentTermCounts(ordinal)) {
+        word_freqs.emplace(dictionary_.GetWord(term), ComputeTermFreq(count, inv_word_count));
     }
+    return word_freqs;
+}
 
-    return id_to_words_freq_.at(document_id);
+MappedArray<SearchServer::TermCount> SearchServer::GetTermCounts(int document_id) const {
+    const int ordinal = FindOrdinal(document_id);
+    return ordinal < 0 ? MappedArray<TermCount>{} : GetDocumentTermCounts(ordinal);
 }
 
 void SearchServer::RemoveDocument(int document_id) {
 
-    if (!documents_.count(document_id)) {
+    if (FindOrdinal(document_id) < 0) {
         return;
     }
-    documents_.erase(document_id);
+    OpenDeltaSegment();
+
+    const auto it = id_to_ordinal_.find(document_id);
+    // The ordinal slot stays empty until the documents are renumbered
+    const int ordinal = it->second;
+    id_to_ordinal_.erase(it);
     document_ids_.erase(document_id);
+    documents_.status_ordinals[static_cast<int>(documents_.statuses[ordinal])].Erase(ordinal);
 
+    if (has_delta_segment_ && ordinal < main_ordinal_count_) {
+        RemoveMainSegmentDocument(ordinal);
+    }
+    auto& term_counts = documents_.term_counts[ordinal];
     std::for_each(
         std::execution::seq,
-        id_to_words_freq_[document_id].begin(),
-        id_to_words_freq_[document_id].end(),
-        [&](const std::pair<std::string_view, double>& word) {
-            word_to_id_freqs_[word.first].erase(document_id);
+        term_counts.begin(),
+        term_counts.end(),
+        [&](const std::pair<TermId, uint32_t>& term_count) {
+            auto& postings = term_postings_[term_count.first];
+            postings.ordinal_freqs.erase(ordinal);
+            UpdateLogDocumentFreq(term_count.first);
+            RemoveTermIfUnused(term_count.first);
         }
     );
 
-    id_to_words_freq_.erase(document_id);
+    term_counts = {};
+    UpdateLogDocumentCount();
+    ++index_version_;
+    CompactOrdinalsIfSparse();
 
 }
 
@@ -97,71 +266,269 @@ void SearchServer::RemoveDocument(const std::execution::sequenced_policy, int do
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy, int document_id) {
 
-    if (!document_ids_.count(document_id)) {
+    if (FindOrdinal(document_id) < 0) {
         return;
     }
-    std::vector<std::pair<std::string_view, double>> temp;
+    OpenDeltaSegment();
 
-    temp.reserve(id_to_words_freq_[document_id].size());
-    temp.insert(temp.begin(), id_to_words_freq_[document_id].begin(), id_to_words_freq_[document_id].end());
+    const auto it = id_to_ordinal_.find(document_id);
+    const int ordinal = it->second;
+    if (has_delta_segment_ && ordinal < main_ordinal_count_) {
+        RemoveMainSegmentDocument(ordinal);
+    }
+    TermCounts temp = std::move(documents_.term_counts[ordinal]);
+    documents_.term_counts[ordinal] = {};
 
-    documents_.erase(documents_.find(document_id));
+    id_to_ordinal_.erase(it);
     document_ids_.erase(document_ids_.find(document_id));
-    id_to_words_freq_.erase(id_to_words_freq_.find(document_id));
+    documents_.status_ordinals[static_cast<int>(documents_.statuses[ordinal])].Erase(ordinal);
+    UpdateLogDocumentCount();
+    ++index_version_;
 
 
     std::for_each(
         std::execution::par_unseq,
         temp.begin(),
         temp.end(),
-        [&](const std::pair<std::string_view, double>& word) {
-            word_to_id_freqs_[word.first].erase(document_id);
+        [&](const std::pair<TermId, uint32_t>& term_count) {
+            auto& postings = term_postings_[term_count.first];
+            postings.ordinal_freqs.erase(ordinal);
+            UpdateLogDocumentFreq(term_count.first);
         });
+
+    // The dictionary is not thread-safe
+    for (const auto& [term, count] : temp) {
+        RemoveTermIfUnused(term);
+    }
+    CompactOrdinalsIfSparse();
 }
 
 int SearchServer::GetDocumentCount() const {
-    return static_cast<int>(documents_.size());
+    if (is_snapshot_view_) {
+        return static_cast<int>(documents_.ids.size());
+    }
+    return static_cast<int>(document_ids_.size());
+}
+
+void SearchServer::Freeze(PostingFormat format) {
+    if (frozen_index_) {
+        if (frozen_index_->GetFormat() == format && !has_delta_segment_) {
+            return;
+        }
+        Thaw();
+        CompactOrdinalsIfSparse();
+    }
+    frozen_index_.emplace(term_postings_, format, documents_.word_counts);
+    term_postings_ = {};
+}
+
+void SearchServer::SetResultCacheCapacity(size_t capacity) {
+    if (capacity == 0) {
+        result_cache_.reset();
+    }
+    else {
+        result_cache_ = std::make_unique<QueryResultCache>(capacity);
+    }
+}
+
+QueryResultCache::Stats SearchServer::GetResultCacheStats() const {
+    return result_cache_ ? result_cache_->GetStats() : QueryResultCache::Stats{};
+}
+
+bool SearchServer::IsFrozen() const {
+    return frozen_index_.has_value();
+}
+
+void SearchServer::SaveSnapshot(const std::string& path) const {
+
+    // Live documents are stored in ascending id order without gaps, so a loaded
+    // snapshot finds the ordinal of an id by binary search
+    std::vector<int> ordinals;
+    if (is_snapshot_view_) {
+        ordinals.resize(documents_.ids.size());
+        std::iota(ordinals.begin(), ordinals.end(), 0);
+    }
+    else {
+        ordinals.reserve(id_to_ordinal_.size());
+        for (const auto& [document_id, ordinal] : id_to_ordinal_) {
+            ordinals.push_back(ordinal);
+        }
+    }
+
+    std::vector<int> new_ordinals(documents_.ids.size(), -1);
+    std::vector<int> ids;
+    std::vector<int> ratings;
+    std::vector<DocumentStatus> statuses;
+    std::vector<uint32_t> word_counts;
+    for (const int ordinal : ordinals) {
+        new_ordinals[ordinal] = static_cast<int>(ids.size());
+        ids.push_back(documents_.ids[ordinal]);
+        ratings.push_back(documents_.ratings[ordinal]);
+        statuses.push_back(documents_.statuses[ordinal]);
+        word_counts.push_back(documents_.word_counts[ordinal]);
+    }
+
+    const size_t bitmap_word_count = OrdinalBitmap::GetWordCount(ids.size());
+    std::vector<uint64_t> status_bitmaps(DOCUMENT_STATUS_COUNT * bitmap_word_count, 0);
+    for (size_t ordinal = 0; ordinal < statuses.size(); ++ordinal) {
+        status_bitmaps[static_cast<int>(statuses[ordinal]) * bitmap_word_count + ordinal / 64] |= uint64_t{ 1 } << (ordinal % 64);
+    }
+
+    IndexSnapshot::Contents contents;
+    contents.stop_words.assign(stop_words_.GetWords().begin(), stop_words_.GetWords().end());
+    contents.log_document_count = log_document_count_;
+
+    // Postings are built from the term counts kept per document, which do not
+    // depend on the format or the segments of the frozen index
+    std::vector<uint64_t> document_freqs(dictionary_.GetIdLimit(), 0);
+    std::vector<uint64_t> forward_offsets(ids.size() + 1, 0);
+    for (const int ordinal : ordinals) {
+        const auto term_counts = GetDocumentTermCounts(ordinal);
+        for (const auto& [term, count] : term_counts) {
+            ++document_freqs[term];
+        }
+        forward_offsets[new_ordinals[ordinal] + 1] = term_counts.size();
+    }
+
+    // Terms are renumbered in word order, dropping unused ids
+    std::vector<TermId> terms;
+    for (TermId term = 0; term < document_freqs.size(); ++term) {
+        if (document_freqs[term] > 0) {
+            terms.push_back(term);
+        }
+    }
+    std::sort(terms.begin(), terms.end(), [this](TermId lhs, TermId rhs) {
+        return dictionary_.GetWord(lhs) < dictionary_.GetWord(rhs);
+    });
+
+    std::vector<TermId> new_terms(document_freqs.size());
+    std::vector<double> log_document_freqs;
+    std::vector<uint64_t> posting_offsets{ 0 };
+    for (const TermId term : terms) {
+        new_terms[term] = static_cast<TermId>(contents.terms.size());
+        contents.terms.push_back(dictionary_.GetWord(term));
+        log_document_freqs.push_back(std::log(document_freqs[term]));
+        posting_offsets.push_back(posting_offsets.back() + document_freqs[term]);
+    }
+
+    // Documents are walked in new ordinal order, which keeps every posting list sorted
+    std::vector<double> max_term_freqs(terms.size(), 0.0);
+    std::vector<int> posting_ordinals(posting_offsets.back());
+    std::vector<uint32_t> posting_counts(posting_offsets.back());
+    std::vector<double> posting_term_freqs(posting_offsets.back());
+    std::vector<uint64_t> posting_positions(posting_offsets.begin(), posting_offsets.end() - 1);
+    for (const int ordinal : ordinals) {
+        const double inv_word_count = 1.0 / documents_.word_counts[ordinal];
+        for (const auto& [term, count] : GetDocumentTermCounts(ordinal)) {
+            const TermId new_term = new_terms[term];
+            const uint64_t position = posting_positions[new_term]++;
+            const double term_freq = ComputeTermFreq(count, inv_word_count);
+            posting_ordinals[position] = new_ordinals[ordinal];
+            posting_counts[position] = count;
+            posting_term_freqs[position] = term_freq;
+            max_term_freqs[new_term] = std::max(max_term_freqs[new_term], term_freq);
+        }
+    }
+
+    // The forward index is the transposed posting matrix; walking terms in order
+    // leaves the terms of every document sorted
+    std::partial_sum(forward_offsets.begin(), forward_offsets.end(), forward_offsets.begin());
+    std::vector<std::pair<TermId, uint32_t>> forward_term_counts(posting_ordinals.size());
+    std::vector<uint64_t> positions(forward_offsets.begin(), forward_offsets.end() - 1);
+    for (TermId term = 0; term < terms.size(); ++term) {
+        for (uint64_t i = posting_offsets[term]; i < posting_offsets[term + 1]; ++i) {
+            forward_term_counts[positions[posting_ordinals[i]]++] = { term, posting_counts[i] };
+        }
+    }
+
+    contents.log_document_freqs = MappedArray<double>(std::move(log_document_freqs));
+    contents.max_term_freqs = MappedArray<double>(std::move(max_term_freqs));
+    contents.posting_offsets = MappedArray<uint64_t>(std::move(posting_offsets));
+    contents.posting_ordinals = MappedArray<int>(std::move(posting_ordinals));
+    contents.posting_term_freqs = MappedArray<double>(std::move(posting_term_freqs));
+    contents.document_ids = MappedArray<int>(std::move(ids));
+    contents.document_ratings = MappedArray<int>(std::move(ratings));
+    contents.document_statuses = MappedArray<DocumentStatus>(std::move(statuses));
+    contents.document_word_counts = MappedArray<uint32_t>(std::move(word_counts));
+    contents.document_status_bitmaps = MappedArray<uint64_t>(std::move(status_bitmaps));
+    contents.forward_offsets = MappedArray<uint64_t>(std::move(forward_offsets));
+    contents.forward_term_counts = MappedArray<std::pair<TermId, uint32_t>>(std::move(forward_term_counts));
+
+    IndexSnapshot::Write(path, contents);
+}
+
+SearchServer SearchServer::LoadSnapshot(const std::string& path) {
+
+    auto snapshot = std::make_shared<IndexSnapshot>(path);
+    const auto& contents = snapshot->GetContents();
+
+    SearchServer server(contents.stop_words);
+    for (const std::string_view term : contents.terms) {
+        if (server.dictionary_.AddView(term) + 1 != server.dictionary_.GetIdLimit()) {
+            throw std::runtime_error("Duplicate term in snapshot dictionary");
+        }
+    }
+    server.frozen_index_.emplace(contents.log_document_freqs, contents.max_term_freqs, contents.posting_offsets,
+        contents.posting_ordinals, contents.posting_term_freqs);
+    server.documents_.ids = contents.document_ids;
+    server.documents_.ratings = contents.document_ratings;
+    server.documents_.statuses = contents.document_statuses;
+    server.documents_.word_counts = contents.document_word_counts;
+    const size_t bitmap_word_count = OrdinalBitmap::GetWordCount(contents.document_ids.size());
+    for (int status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+        server.documents_.status_ordinals[status] = OrdinalBitmap(MappedArray<uint64_t>(
+            contents.document_status_bitmaps.data() + status * bitmap_word_count, bitmap_word_count));
+    }
+    server.log_document_count_ = contents.log_document_count;
+    server.snapshot_ = std::move(snapshot);
+    server.is_snapshot_view_ = true;
+
+    return server;
 }
 
 
-std::set<int>::const_iterator SearchServer::begin() const {
-    return document_ids_.begin();
+SearchServer::DocumentIdIterator SearchServer::begin() const {
+    DocumentIdIterator it;
+    if (is_snapshot_view_) {
+        it.column_id_ = documents_.ids.begin();
+    }
+    else {
+        it.set_id_ = document_ids_.begin();
+    }
+    return it;
 }
 
-std::set<int>::const_iterator SearchServer::end() const {
-    return document_ids_.end();
+SearchServer::DocumentIdIterator SearchServer::end() const {
+    DocumentIdIterator it;
+    if (is_snapshot_view_) {
+        it.column_id_ = documents_.ids.end();
+    }
+    else {
+        it.set_id_ = document_ids_.end();
+    }
+    return it;
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query,
     int document_id) const {
     const auto query = ParseQuery(raw_query);
+    const int ordinal = GetOrdinal(document_id);
 
-    bool is_any_minus_words = false;
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_id_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_id_freqs_.at(word).count(document_id)) {
-            is_any_minus_words = true;
+    for (const TermId term : query.minus_terms) {
+        if (HasDocumentWithTerm(term, ordinal)) {
+            return { std::vector<std::string_view>{}, documents_.statuses[ordinal] };
         }
     }
-    if (is_any_minus_words) {
-        return { {}, documents_.at(document_id).status };
-    }
 
     std::vector<std::string_view> matched_words;
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_id_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_id_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word_to_id_freqs_.find(word)->first);
+    for (const TermId term : query.plus_terms) {
+        if (HasDocumentWithTerm(term, ordinal)) {
+            matched_words.push_back(dictionary_.GetWord(term));
         }
     }
-    
-   
-    
-    return { matched_words, documents_.at(document_id).status };
+    std::sort(matched_words.begin(), matched_words.end());
+
+    return { matched_words, documents_.statuses[ordinal] };
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy, const std::string_view raw_query,int document_id) const {
@@ -173,40 +540,34 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
     int document_id) const {
 
     const Query parsed_query = ParseQuery(std::execution::par, raw_query);
+    const int ordinal = GetOrdinal(document_id);
 
     bool is_any_minus_words = std::any_of(
         std::execution::par_unseq,
-        parsed_query.minus_words.begin(),
-        parsed_query.minus_words.end(),
-        [&](const std::string_view& word) {
-
-            const auto it = word_to_id_freqs_.find(word);
-
-            return (it != word_to_id_freqs_.end() &&
-                it->second.find(document_id) != it->second.end());
+        parsed_query.minus_terms.begin(),
+        parsed_query.minus_terms.end(),
+        [&](TermId term) {
+            return HasDocumentWithTerm(term, ordinal);
         }
     );
     
     if (is_any_minus_words) {
-        return { {}, documents_.at(document_id).status};
+        return { std::vector<std::string_view>{}, documents_.statuses[ordinal] };
     }
 
-    std::vector<std::string_view> matched_documents(parsed_query.plus_words.size());
+    std::vector<std::string_view> matched_documents(parsed_query.plus_terms.size());
 
     std::transform(
         std::execution::par_unseq,
-        parsed_query.plus_words.begin(),
-        parsed_query.plus_words.end(),
+        parsed_query.plus_terms.begin(),
+        parsed_query.plus_terms.end(),
         matched_documents.begin(),
-        [&](const std::string_view& word) {
+        [&](TermId term) {
 
             using namespace std::string_view_literals;
 
-            const auto it = word_to_id_freqs_.find(word); 
-
-            return (it != word_to_id_freqs_.end() &&
-                it->second.find(document_id) != it->second.end())
-                ? it->first
+            return HasDocumentWithTerm(term, ordinal)
+                ? dictionary_.GetWord(term)
                 : ""sv;
         }
     );
@@ -225,17 +586,21 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
             std::execution::par_unseq,
             matched_documents.begin(),
             matched_documents.end()
-        ) - 1,
+        ),
         matched_documents.end()
     );
+    // Unmatched words were mapped to the empty view, which sorts last
+    if (!matched_documents.empty() && matched_documents.back().empty()) {
+        matched_documents.pop_back();
+    }
 
-    return { matched_documents, documents_.at(document_id).status };
+    return { matched_documents, documents_.statuses[ordinal] };
 
 }
 
 
 bool SearchServer::IsStopWord(const std::string_view word) const {
-    return stop_words_.find(word) != stop_words_.end();
+    return stop_words_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(const std::string_view word) {
@@ -245,23 +610,339 @@ bool SearchServer::IsValidWord(const std::string_view word) {
         });
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
+void SearchServer::SplitIntoWordsNoStop(const std::string_view text, std::vector<std::string_view>& words) const {
 
     using namespace std;
 
-    const auto splitted = SplitIntoWords(text);
+    const size_t invalid_word = TokenizeWords(text, words);
+    if (invalid_word != string_view::npos) {
+        throw std::invalid_argument("Word "s + std::string(words[invalid_word]) + " is invalid"s);
+    }
+    words.erase(
+        remove_if(words.begin(), words.end(), [this](const string_view word) { return IsStopWord(word); }),
+        words.end());
+}
 
-    std::vector<std::string_view> words;
-    words.reserve(splitted.size());
-    for (const std::string_view& word : splitted) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("Word "s + std::string(word) + " is invalid"s);
+void SearchServer::Thaw() {
+    if (!frozen_index_) {
+        return;
+    }
+    if (!has_delta_segment_) {
+        term_postings_ = frozen_index_->BuildPostings();
+    }
+    else {
+        // Removed documents may still be in the main segment, the live ones are known per document
+        std::vector<int> ordinals(documents_.ids.size());
+        std::iota(ordinals.begin(), ordinals.end(), 0);
+        term_postings_ = BuildLivePostings(ordinals);
+    }
+    frozen_index_.reset();
+    has_delta_segment_ = false;
+    main_ordinal_count_ = 0;
+    tombstones_ = {};
+    main_document_freqs_ = {};
+    DetachFromSnapshot();
+}
+
+void SearchServer::OpenDeltaSegment() {
+    if (!frozen_index_ || has_delta_segment_) {
+        return;
+    }
+    DetachFromSnapshot();
+
+    // The frozen index becomes the main segment; new postings go to the maps and
+    // removed main documents are only marked until the next merge
+    main_ordinal_count_ = static_cast<int>(documents_.ids.size());
+    term_postings_.assign(dictionary_.GetIdLimit(), WordPostings{});
+    main_document_freqs_.assign(dictionary_.GetIdLimit(), 0);
+    for (TermId term = 0; term < term_postings_.size(); ++term) {
+        term_postings_[term].log_document_freq = frozen_index_->GetLogDocumentFreq(term);
+        main_document_freqs_[term] = static_cast<int>(frozen_index_->GetPostingCount(term));
+    }
+    tombstones_ = {};
+    has_delta_segment_ = true;
+}
+
+void SearchServer::RemoveMainSegmentDocument(int ordinal) {
+    tombstones_.Insert(ordinal);
+    for (const auto& [term, count] : documents_.term_counts[ordinal]) {
+        --main_document_freqs_[term];
+        UpdateLogDocumentFreq(term);
+        RemoveTermIfUnused(term);
+    }
+    documents_.term_counts[ordinal] = {};
+}
+
+std::vector<WordPostings> SearchServer::BuildLivePostings(const std::vector<int>& new_ordinals) const {
+    std::vector<WordPostings> term_postings(dictionary_.GetIdLimit());
+    for (size_t ordinal = 0; ordinal < new_ordinals.size(); ++ordinal) {
+        if (new_ordinals[ordinal] < 0) {
+            continue;
+        }
+        const double inv_word_count = 1.0 / documents_.word_counts[ordinal];
+        for (const auto& [term, count] : GetDocumentTermCounts(static_cast<int>(ordinal))) {
+            auto& ordinal_freqs = term_postings[term].ordinal_freqs;
+            ordinal_freqs.emplace_hint(ordinal_freqs.end(), new_ordinals[ordinal], ComputeTermFreq(count, inv_word_count));
+        }
+    }
+    for (auto& postings : term_postings) {
+        const size_t document_freq = postings.ordinal_freqs.size();
+        postings.log_document_freq = document_freq == 0 ? 0.0 : std::log(document_freq);
+    }
+    return term_postings;
+}
+
+size_t SearchServer::GetDeltaSegmentSize() const {
+    if (!has_delta_segment_) {
+        return frozen_index_ ? 0 : documents_.ids.size();
+    }
+    size_t removed_count = 0;
+    for (const uint64_t word : tombstones_.GetWords()) {
+        removed_count += __builtin_popcountll(word);
+    }
+    return documents_.ids.size() - main_ordinal_count_ + removed_count;
+}
+
+SearchServer::SegmentMerge SearchServer::PrepareSegmentMerge() const {
+    SegmentMerge merge;
+    merge.end_ordinal = static_cast<int>(documents_.ids.size());
+    merge.ordinal_generation = ordinal_generation_;
+    merge.live_ordinals = GetLiveOrdinals();
+
+    // Removed documents are dropped and the live ones keep their order
+    std::vector<uint32_t> word_counts;
+    merge.new_ordinals.assign(merge.end_ordinal, -1);
+    for (int ordinal = 0; ordinal < merge.end_ordinal; ++ordinal) {
+        if (merge.live_ordinals.Contains(ordinal)) {
+            merge.new_ordinals[ordinal] = static_cast<int>(word_counts.size());
+            word_counts.push_back(documents_.word_counts[ordinal]);
+        }
+    }
+    merge.index = FrozenIndex(BuildLivePostings(merge.new_ordinals),
+        frozen_index_ ? frozen_index_->GetFormat() : PostingFormat::PLAIN, MappedArray<uint32_t>(std::move(word_counts)));
+    return merge;
+}
+
+bool SearchServer::CommitSegmentMerge(const SegmentMerge& merge) {
+
+    // Postings of the merge refer to the ordinals it was prepared with, and it has to
+    // cover the current main segment
+    const int main_ordinal_count = has_delta_segment_ ? main_ordinal_count_
+        : frozen_index_ ? static_cast<int>(documents_.ids.size()) : 0;
+    if (merge.ordinal_generation != ordinal_generation_ || merge.end_ordinal < main_ordinal_count) {
+        return false;
+    }
+    if (frozen_index_) {
+        OpenDeltaSegment();
+    }
+    else {
+        main_ordinal_count_ = 0;
+        main_document_freqs_.assign(term_postings_.size(), 0);
+    }
+
+    // Delta postings that the merge covers move to the main segment; the document
+    // frequency of every term stays the same
+    for (TermId term = 0; term < term_postings_.size(); ++term) {
+        auto& ordinal_freqs = term_postings_[term].ordinal_freqs;
+        const auto last = ordinal_freqs.lower_bound(merge.end_ordinal);
+        main_document_freqs_[term] += static_cast<int>(std::distance(ordinal_freqs.begin(), last));
+        ordinal_freqs.erase(ordinal_freqs.begin(), last);
+    }
+
+    // Documents take the ordinals of the merged index and the ones added since follow
+    // them. Documents removed since the merge was prepared are still in its postings
+    const int ordinal_count = static_cast<int>(documents_.ids.size());
+    const OrdinalBitmap live_ordinals = GetLiveOrdinals();
+    std::vector<int> new_ordinals(merge.new_ordinals);
+    int merged_count = 0;
+    OrdinalBitmap tombstones;
+    for (int ordinal = 0; ordinal < merge.end_ordinal; ++ordinal) {
+        if (new_ordinals[ordinal] < 0) {
+            continue;
+        }
+        if (!live_ordinals.Contains(ordinal)) {
+            tombstones.Insert(new_ordinals[ordinal]);
+        }
+        ++merged_count;
+    }
+    for (int ordinal = merge.end_ordinal; ordinal < ordinal_count; ++ordinal) {
+        new_ordinals.push_back(merged_count + ordinal - merge.end_ordinal);
+    }
+    RenumberOrdinals(new_ordinals);
+
+    frozen_index_ = merge.index;
+    ++index_version_;
+    if (tombstones.GetWords().empty() && merge.end_ordinal == ordinal_count) {
+        // Nothing changed since the merge was prepared, the main segment is the whole index
+        term_postings_ = {};
+        main_document_freqs_ = {};
+        tombstones_ = {};
+        main_ordinal_count_ = 0;
+        has_delta_segment_ = false;
+        return true;
+    }
+    tombstones_ = std::move(tombstones);
+    main_ordinal_count_ = merged_count;
+    has_delta_segment_ = true;
+    return true;
+}
+
+void SearchServer::MergeDeltaSegment() {
+    CommitSegmentMerge(PrepareSegmentMerge());
+}
+
+OrdinalBitmap SearchServer::GetLiveOrdinals() const {
+    std::vector<uint64_t> live_words(OrdinalBitmap::GetWordCount(documents_.ids.size()), 0);
+    for (const OrdinalBitmap& status_ordinals : documents_.status_ordinals) {
+        const auto& words = status_ordinals.GetWords();
+        for (size_t i = 0; i < words.size() && i < live_words.size(); ++i) {
+            live_words[i] |= words[i];
+        }
+    }
+    return OrdinalBitmap(MappedArray<uint64_t>(std::move(live_words)));
+}
+
+void SearchServer::DetachFromSnapshot() {
+    if (is_snapshot_view_) {
+        // Ids of a snapshot are sorted, so every insertion goes to the end
+        const size_t document_count = documents_.ids.size();
+        documents_.term_counts.resize(document_count);
+        for (size_t ordinal = 0; ordinal < document_count; ++ordinal) {
+            const int document_id = documents_.ids[ordinal];
+            id_to_ordinal_.emplace_hint(id_to_ordinal_.end(), document_id, static_cast<int>(ordinal));
+            document_ids_.insert(document_ids_.end(), document_id);
+            const auto term_counts = GetDocumentTermCounts(static_cast<int>(ordinal));
+            documents_.term_counts[ordinal].assign(term_counts.begin(), term_counts.end());
+        }
+        documents_.ids.MakeOwning();
+        documents_.ratings.MakeOwning();
+        documents_.statuses.MakeOwning();
+        documents_.word_counts.MakeOwning();
+        is_snapshot_view_ = false;
+    }
+}
+
+int SearchServer::GetOrdinal(int document_id) const {
+    using namespace std;
+    const int ordinal = FindOrdinal(document_id);
+    if (ordinal < 0) {
+        throw out_of_range("No document with id "s + to_string(document_id));
+    }
+    return ordinal;
+}
+
+int SearchServer::FindOrdinal(int document_id) const {
+    if (is_snapshot_view_) {
+        const int* const it = std::lower_bound(documents_.ids.begin(), documents_.ids.end(), document_id);
+        return it != documents_.ids.end() && *it == document_id ? static_cast<int>(it - documents_.ids.begin()) : -1;
+    }
+    const auto it = id_to_ordinal_.find(document_id);
+    return it != id_to_ordinal_.end() ? it->second : -1;
+}
+
+MappedArray<SearchServer::TermCount> SearchServer::GetDocumentTermCounts(int ordinal) const {
+    if (is_snapshot_view_) {
+        const auto& contents = snapshot_->GetContents();
+        const uint64_t first = contents.forward_offsets[ordinal];
+        return MappedArray<TermCount>(contents.forward_term_counts.data() + first,
+            contents.forward_offsets[ordinal + 1] - first);
+    }
+    const TermCounts& term_counts = documents_.term_counts[ordinal];
+    return MappedArray<TermCount>(term_counts.data(), term_counts.size());
+}
+
+bool SearchServer::HasDocumentWithTerm(TermId term, int ordinal) const {
+    if (frozen_index_ && (!has_delta_segment_ || ordinal < main_ordinal_count_)) {
+        return frozen_index_->HasDocument(term, ordinal);
+    }
+    return term_postings_[term].ordinal_freqs.count(ordinal) > 0;
+}
+
+TermId SearchServer::FindOrAddTerm(const std::string_view word) {
+    const TermId term = dictionary_.Add(word);
+    if (term >= term_postings_.size()) {
+        term_postings_.resize(term + 1);
+    }
+    if (has_delta_segment_ && term >= main_document_freqs_.size()) {
+        main_document_freqs_.resize(term + 1, 0);
+    }
+    return term;
+}
+
+void SearchServer::RemoveTermIfUnused(TermId term) {
+    WordPostings& postings = term_postings_[term];
+    if (!postings.ordinal_freqs.empty() || (has_delta_segment_ && main_document_freqs_[term] > 0)) {
+        return;
+    }
+    postings = {};
+    dictionary_.Remove(term);
+}
+
+void SearchServer::CompactOrdinalsIfSparse() {
+
+    // Ordinals of the main segment are fixed until a merge or Freeze rebuilds it
+    const size_t ordinal_count = documents_.ids.size();
+    if (frozen_index_ || ordinal_count < 2 * id_to_ordinal_.size()) {
+        return;
+    }
+
+    std::vector<int> new_ordinals(ordinal_count, -1);
+    for (const auto& [document_id, ordinal] : id_to_ordinal_) {
+        new_ordinals[ordinal] = 0;
+    }
+    int next_ordinal = 0;
+    for (int& new_ordinal : new_ordinals) {
+        if (new_ordinal == 0) {
+            new_ordinal = next_ordinal++;
         }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+    }
+    RenumberOrdinals(new_ordinals);
+}
+
+void SearchServer::RenumberOrdinals(const std::vector<int>& new_ordinals) {
+
+    using namespace std;
+
+    ++ordinal_generation_;
+
+    // Kept documents keep their relative order, so posting maps can be rebuilt by appending
+    vector<int> ids;
+    vector<int> ratings;
+    vector<DocumentStatus> statuses;
+    vector<uint32_t> word_counts;
+    vector<TermCounts> term_counts;
+    array<OrdinalBitmap, DOCUMENT_STATUS_COUNT> status_ordinals;
+    for (size_t ordinal = 0; ordinal < new_ordinals.size(); ++ordinal) {
+        if (new_ordinals[ordinal] < 0) {
+            continue;
         }
+        const int status = static_cast<int>(documents_.statuses[ordinal]);
+        if (documents_.status_ordinals[status].Contains(static_cast<int>(ordinal))) {
+            status_ordinals[status].Insert(new_ordinals[ordinal]);
+        }
+        ids.push_back(documents_.ids[ordinal]);
+        ratings.push_back(documents_.ratings[ordinal]);
+        statuses.push_back(documents_.statuses[ordinal]);
+        word_counts.push_back(documents_.word_counts[ordinal]);
+        term_counts.push_back(move(documents_.term_counts[ordinal]));
+    }
+    documents_.ids = MappedArray<int>(move(ids));
+    documents_.ratings = MappedArray<int>(move(ratings));
+    documents_.statuses = MappedArray<DocumentStatus>(move(statuses));
+    documents_.word_counts = MappedArray<uint32_t>(move(word_counts));
+    documents_.term_counts = move(term_counts);
+    documents_.status_ordinals = move(status_ordinals);
+
+    for (auto& postings : term_postings_) {
+        map<int, double> ordinal_freqs;
+        for (const auto& [ordinal, term_freq] : postings.ordinal_freqs) {
+            ordinal_freqs.emplace_hint(ordinal_freqs.end(), new_ordinals[ordinal], term_freq);
+        }
+        postings.ordinal_freqs = move(ordinal_freqs);
+    }
+    for (auto& [document_id, ordinal] : id_to_ordinal_) {
+        ordinal = new_ordinals[ordinal];
     }
-    return words;
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
@@ -289,52 +970,73 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text
     else {
         word = text;
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
-        throw std::invalid_argument("Query word "s + std::string(text) + " is invalid");
+    // Control characters are rejected while the query is tokenized
+    if (word.empty() || word[0] == '-') {
+        ThrowInvalidQueryWord(text);
     }
 
     return { word, is_minus, IsStopWord(word) };
 }
 
+void SearchServer::ThrowInvalidQueryWord(const std::string_view text) {
+    using namespace std;
+    throw std::invalid_argument("Query word "s + std::string(text) + " is invalid");
+}
+
 SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const {
 
     SearchServer::Query result;
-    
+    std::vector<std::string_view> words;
+    ParseQuery(text, words, result);
+    return result;
+}
+
+void SearchServer::ParseQuery(const std::string_view text, std::vector<std::string_view>& words, Query& result) const {
+
+    PROFILE_QUERY_STAGE(QueryStage::PARSE);
+
+    result.plus_terms.clear();
+    result.minus_terms.clear();
 
-    for (const std::string_view word : SplitIntoWords(text)) {
-        const auto query_word = ParseQueryWord(word);
+    const size_t invalid_word = TokenizeWords(text, words);
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (i == invalid_word) {
+            ThrowInvalidQueryWord(words[i]);
+        }
+        const auto query_word = ParseQueryWord(words[i]);
         if (!query_word.is_stop) {
+            const TermId term = dictionary_.Find(query_word.data);
+            if (term == TermDictionary::NO_TERM) {
+                continue;
+            }
             if (query_word.is_minus) {
-                result.minus_words.push_back(std::string(query_word.data));
+                result.minus_terms.push_back(term);
             }
             else {
-                result.plus_words.push_back(std::string(query_word.data));
+                result.plus_terms.push_back(term);
             }
         }
     }
 
     std::sort(
         std::execution::seq,
-        result.minus_words.begin(),
-        result.minus_words.end()
+        result.minus_terms.begin(),
+        result.minus_terms.end()
     );
-    result.minus_words.erase(
-        std::unique(std::execution::seq, result.minus_words.begin(), result.minus_words.end()),
-        result.minus_words.end()
+    result.minus_terms.erase(
+        std::unique(std::execution::seq, result.minus_terms.begin(), result.minus_terms.end()),
+        result.minus_terms.end()
     );
 
     std::sort(
         std::execution::seq,
-        result.plus_words.begin(),
-        result.plus_words.end()
+        result.plus_terms.begin(),
+        result.plus_terms.end()
     );
-    result.plus_words.erase(
-        std::unique(std::execution::seq, result.plus_words.begin(), result.plus_words.end()),
-        result.plus_words.end()
+    result.plus_terms.erase(
+        std::unique(std::execution::seq, result.plus_terms.begin(), result.plus_terms.end()),
+        result.plus_terms.end()
     );
-
-    return result;
-
 }
 
 
@@ -342,18 +1044,23 @@ SearchServer::Query SearchServer::ParseQuery(const std::execution::parallel_poli
 
     SearchServer::Query result;
 
-    const auto splitted = SplitIntoWords(text);
+    std::vector<std::string_view> splitted;
+    const size_t invalid_word = TokenizeWords(text, splitted);
 
-    result.minus_words.reserve(splitted.size());
-    result.plus_words.reserve(splitted.size());
+    result.minus_terms.reserve(splitted.size());
+    result.plus_terms.reserve(splitted.size());
 
 
-    for (const std::string_view& word : splitted) {
-        const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
+    for (size_t i = 0; i < splitted.size(); ++i) {
+        if (i == invalid_word) {
+            ThrowInvalidQueryWord(splitted[i]);
+        }
+        const auto query_word = ParseQueryWord(splitted[i]);
+        const TermId term = dictionary_.Find(query_word.data);
+        if (!query_word.is_stop && term != TermDictionary::NO_TERM) {
             query_word.is_minus
-                ? result.minus_words.push_back(static_cast<std::string>((query_word.data)))
-                : result.plus_words.push_back(static_cast<std::string>((query_word.data)));
+                ? result.minus_terms.push_back(term)
+                : result.plus_terms.push_back(term);
         }
     }
     return result;
@@ -361,6 +1068,109 @@ SearchServer::Query SearchServer::ParseQuery(const std::execution::parallel_poli
 }
 
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_id_freqs_.at(word).size());
+void SearchServer::UpdateLogDocumentCount() {
+    const int document_count = GetDocumentCount();
+    log_document_count_ = document_count == 0 ? 0.0 : std::log(document_count);
+}
+
+void SearchServer::UpdateLogDocumentFreq(TermId term) {
+    WordPostings& postings = term_postings_[term];
+    const size_t document_freq = postings.ordinal_freqs.size()
+        + (has_delta_segment_ ? main_document_freqs_[term] : 0);
+    postings.log_document_freq = document_freq == 0 ? 0.0 : std::log(document_freq);
+}
+
+void SearchServer::PrepareShards(QueryContext& context, size_t shard_count) const {
+
+    const Query& query = context.query_;
+    RelevanceAccumulator& accumulator = context.accumulator_;
+    // MaxScore scores a window at a time and needs no slot per document
+    accumulator.Reset(documents_.ids.size(), shard_count, !UsesMaxScore());
+
+    auto& inverse_document_freqs = context.inverse_document_freqs_;
+    inverse_document_freqs.assign(query.plus_terms.size(), 0.0);
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        inverse_document_freqs[i] = ComputeTermInverseDocumentFreq(query.plus_terms[i]);
+    }
+
+    auto& shards = context.shards_;
+    shards.resize(accumulator.GetShardCount());
+    std::iota(shards.begin(), shards.end(), 0);
+    context.heaps_.resize(shards.size());
+
+    if (UsesMaxScore()) {
+        PrepareMaxScore(context, shards.size());
+    }
+}
+
+const std::vector<Document>& SearchServer::FindTopDocumentsPart(QueryContext& context, const std::string_view raw_query,
+    const DocumentFilter& filter, size_t part, size_t part_count, size_t top_count) const {
+
+    ParseQuery(raw_query, context.words_, context.query_);
+    PrepareShards(context, part_count);
+
+    // Small indexes have fewer ranges than parts
+    if (part >= context.shards_.size()) {
+        context.results_.clear();
+        return context.results_;
+    }
+    const int min_rating = filter.min_rating;
+    const int max_rating = filter.max_rating;
+    FindShardDocuments(context, part, &documents_.status_ordinals[static_cast<int>(filter.status)],
+        [min_rating, max_rating](int, DocumentStatus, int rating) {
+            return min_rating <= rating && rating <= max_rating;
+        }, top_count);
+    PROFILE_QUERY_STAGE(QueryStage::RESULT_BUILD);
+    context.heaps_[part].ExtractTo(context.results_);
+    return context.results_;
+}
+
+bool SearchServer::UsesMaxScore() const {
+    return frozen_index_ && !has_delta_segment_;
+}
+
+void SearchServer::PrepareMaxScore(QueryContext& context, size_t shard_count) const {
+
+    const auto& plus_terms = context.query_.plus_terms;
+    const auto& inverse_document_freqs = context.inverse_document_freqs_;
+
+    // Contributions of a term never exceed its largest term frequency times its IDF
+    auto& term_bounds = context.term_bounds_;
+    term_bounds.resize(plus_terms.size());
+    for (size_t i = 0; i < plus_terms.size(); ++i) {
+        term_bounds[i] = frozen_index_->GetMaxTermFreq(plus_terms[i]) * std::max(0.0, inverse_document_freqs[i]);
+    }
+
+    auto& term_order = context.term_order_;
+    term_order.resize(plus_terms.size());
+    std::iota(term_order.begin(), term_order.end(), 0);
+    std::sort(term_order.begin(), term_order.end(), [&term_bounds](size_t lhs, size_t rhs) {
+        return term_bounds[lhs] < term_bounds[rhs];
+    });
+
+    auto& term_bound_sums = context.term_bound_sums_;
+    term_bound_sums.resize(plus_terms.size());
+    auto& term_positions = context.term_positions_;
+    term_positions.resize(plus_terms.size());
+    for (size_t j = 0; j < term_order.size(); ++j) {
+        term_bound_sums[j] = term_bounds[term_order[j]];
+        term_positions[term_order[j]] = j;
+    }
+    for (size_t j = 0; j < term_order.size(); ++j) {
+        term_bounds[j] = term_bound_sums[j];
+    }
+    std::partial_sum(term_bound_sums.begin(), term_bound_sums.end(), term_bound_sums.begin());
+
+    context.max_score_shards_.resize(shard_count);
+}
+
+double SearchServer::ComputeTermInverseDocumentFreq(TermId term) const {
+    if (collection_statistics_ != nullptr) {
+        return collection_statistics_->GetLogDocumentCount()
+            - collection_statistics_->GetLogDocumentFreq(dictionary_.GetWord(term));
+    }
+    if (frozen_index_ && !has_delta_segment_) {
+        return log_document_count_ - frozen_index_->GetLogDocumentFreq(term);
+    }
+    return log_document_count_ - term_postings_[term].log_document_freq;
 }
\ No newline at end of file
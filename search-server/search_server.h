@@ -1,4 +1,5 @@
 #pragma once
+#include "collection_statistics.h"
 #include "document.h"
 #include <set>
 #include <map>
@@ -7,18 +8,35 @@
 #include <algorithm>
 #include "string_processing.h"
 #include <execution>
-#include <deque>
 #include <type_traits>
-#include <mutex>
-#include "concurrent_map.h"
+#include <numeric>
+#include <thread>
+#include "frozen_index.h"
+#include "index_snapshot.h"
+#include "ordinal_bitmap.h"
+#include "query_profiler.h"
+#include "query_result_cache.h"
+#include "relevance_accumulator.h"
+#include "stop_word_set.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
-const double EPSILON = 1e-6;
-
 class SearchServer {
 public:
 
+    // Scratch buffers that one thread reuses across queries; after warm-up
+    // a search through a context performs no heap allocations
+    class QueryContext;
+
     template <typename StringContainer>
     explicit SearchServer(const StringContainer& stop_words);
 
@@ -26,9 +44,27 @@ public:
 
     explicit SearchServer(std::string_view stop_words_text);
 
+    // A copy shares a loaded snapshot with the original; its result cache starts empty
+    SearchServer(const SearchServer& other);
+    SearchServer(SearchServer&&) = default;
+
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status,
         const std::vector<int>& ratings);
 
+    struct NewDocument {
+        int id = 0;
+        std::string_view text;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+        std::vector<int> ratings;
+    };
+
+    // Adds a batch of documents with the same validation as AddDocument.
+    // Documents are tokenized in parallel chunks and merged into the index in one pass;
+    // if any document is invalid, nothing from the batch is added
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    template <typename ExePolicy>
+    void AddDocuments(const ExePolicy& policy, const std::vector<NewDocument>& documents);
+
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query,
         DocumentPredicate document_predicate) const;
@@ -42,16 +78,97 @@ public:
     template<typename ExePolicy>
     std::vector<Document> FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query) const;
 
+    // Return up to top_count best documents instead of MAX_RESULT_DOCUMENT_COUNT
+    template <typename DocumentPredicate, typename ExePolicy>
+    std::vector<Document> FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query,
+        DocumentPredicate document_predicate, size_t top_count) const;
+    template<typename ExePolicy>
+    std::vector<Document> FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query,
+        DocumentStatus status, size_t top_count) const;
+
+    // Filters by status through per-status bitmaps of documents instead of
+    // calling a predicate for every posting, ratings are compared in place
+    template<typename ExePolicy>
+    std::vector<Document> FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query,
+        const DocumentFilter& filter, size_t top_count) const;
+
+    // Return at most limit documents that follow the first offset ones in ranking order
+    template <typename DocumentPredicate, typename ExePolicy>
+    std::vector<Document> FindTopDocumentsPage(const ExePolicy& policy, const std::string_view raw_query,
+        DocumentPredicate document_predicate, size_t offset, size_t limit) const;
+    template<typename ExePolicy>
+    std::vector<Document> FindTopDocumentsPage(const ExePolicy& policy, const std::string_view raw_query,
+        DocumentStatus status, size_t offset, size_t limit) const;
+
+    // Results are stored in the context and stay valid until its next query.
+    // Parsed words refer to raw_query, which only has to outlive the call
+    template <typename DocumentPredicate, typename ExePolicy>
+    const std::vector<Document>& FindTopDocuments(const ExePolicy& policy, QueryContext& context,
+        const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count) const;
+    const std::vector<Document>& FindTopDocuments(QueryContext& context, const std::string_view raw_query,
+        DocumentStatus status) const;
+    const std::vector<Document>& FindTopDocuments(QueryContext& context, const std::string_view raw_query) const;
+
     int GetDocumentCount() const;
 
+    // Caches results of status and filter queries for up to capacity distinct queries; 0 disables
+    // the cache. Custom predicates bypass it, any change of the index invalidates it
+    void SetResultCacheCapacity(size_t capacity);
+    QueryResultCache::Stats GetResultCacheStats() const;
+
+    // Compacts the inverted index into the read-optimized CSR layout.
+    // Later changes go to a small delta segment on top of it: added documents are
+    // kept in posting maps and removed ones are marked until the next merge or Freeze,
+    // which also renumbers documents
+    void Freeze(PostingFormat format = PostingFormat::PLAIN);
+    bool IsFrozen() const;
+
+    // A frozen index of the live documents built without changing the server
+    struct SegmentMerge {
+        FrozenIndex index;
+        int end_ordinal = 0;
+        OrdinalBitmap live_ordinals;
+        // Ordinal in the merged index of every document below end_ordinal, -1 for removed ones
+        std::vector<int> new_ordinals;
+        uint64_t ordinal_generation = 0;
+    };
+
+    // Documents added and removed since the last merge, all documents of an unfrozen server
+    size_t GetDeltaSegmentSize() const;
+
+    // Merging is split so that the expensive part can run on a copy of the server.
+    // CommitSegmentMerge makes the merged index the main segment, keeping changes made
+    // after PrepareSegmentMerge in the delta, and renumbers documents without the removed
+    // ones; it returns false, changing nothing, if documents have been renumbered since
+    SegmentMerge PrepareSegmentMerge() const;
+    bool CommitSegmentMerge(const SegmentMerge& merge);
+    void MergeDeltaSegment();
+
+    // Writes the whole server state to a file that LoadSnapshot maps into memory.
+    // A loaded server is frozen and answers queries and lookups by document id
+    // straight from the mapping; mutations copy everything out
+    void SaveSnapshot(const std::string& path) const;
+    static SearchServer LoadSnapshot(const std::string& path);
+
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy, int documnet_id);
     void RemoveDocument(const std::execution::parallel_policy, int document_id);
 
-    std::set<int>::const_iterator begin() const;
-    std::set<int>::const_iterator end() const;
+    // Ids of all documents in ascending order
+    class DocumentIdIterator;
+    DocumentIdIterator begin() const;
+    DocumentIdIterator end() const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Occurrence count of a term in a document. The term frequency is ComputeTermFreq
+    // of the count and the inverse number of the document's words
+    using TermCount = std::pair<TermId, uint32_t>;
+
+    // Words here and in MatchDocument results refer to the server's dictionary. Any
+    // RemoveDocument call may free words that no document uses any more, so the views
+    // are valid only until the next RemoveDocument and have to be copied to be kept longer
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+    // Counts of the document's terms sorted by term id, a view that stays valid until the next change
+    MappedArray<TermCount> GetTermCounts(int document_id) const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query,
         int document_id) const;
@@ -62,25 +179,113 @@ public:
 
 
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
+    friend class BatchQueryExecutor;
+    friend class ShardedSearchServer;
+
+    using TermCounts = std::vector<TermCount>;
+
+    // Per-document data as parallel arrays indexed by the dense ordinal
+    // that AddDocument assigns; external ids are only needed at the API boundary
+    struct DocumentTable {
+        MappedArray<int> ids;
+        MappedArray<int> ratings;
+        MappedArray<DocumentStatus> statuses;
+        // Words left after stop words are dropped
+        MappedArray<uint32_t> word_counts;
+        // Empty while the server is a snapshot view, which reads the forward index of the snapshot
+        std::vector<TermCounts> term_counts;
+        // Live documents of every status, indexed by DocumentStatus
+        std::array<OrdinalBitmap, DOCUMENT_STATUS_COUNT> status_ordinals;
     };
-    const std::set<std::string, std::less<>> stop_words_;
-    std::deque<std::string> documents_strings_;
-    std::map<std::string_view, std::map<int, double>> word_to_id_freqs_;
-    std::map<int, std::map<std::string_view, double>> id_to_words_freq_;
-    std::map<int, DocumentData> documents_;
+    const StopWordSet stop_words_;
+    // Owns every indexed word; a word is removed together with its last posting
+    TermDictionary dictionary_;
+    // Indexed by term id; empty while the index is frozen without a delta segment
+    std::vector<WordPostings> term_postings_;
+    // log(GetDocumentCount()), so IDF = log_document_count_ - log_document_freq needs no log per query
+    double log_document_count_ = 0.0;
+    DocumentTable documents_;
+    // Empty while the server is a snapshot view, whose ids column is sorted
+    std::map<int, int> id_to_ordinal_;
     std::set<int> document_ids_;
+    std::optional<FrozenIndex> frozen_index_;
+    // Set once a frozen index takes changes: it then holds the documents below
+    // main_ordinal_count_ and term_postings_ the ones above. Removed main documents
+    // stay in the index as tombstones, main_document_freqs_ counts live ones per term
+    bool has_delta_segment_ = false;
+    int main_ordinal_count_ = 0;
+    OrdinalBitmap tombstones_;
+    std::vector<int> main_document_freqs_;
+    // Bumped whenever documents are renumbered
+    uint64_t ordinal_generation_ = 0;
+    // Keeps the mapped file alive: while is_snapshot_view_ is set the frozen index and
+    // the document columns point into it, and after Thaw the dictionary words still do
+    std::shared_ptr<IndexSnapshot> snapshot_;
+    bool is_snapshot_view_ = false;
+    // Bumped by every change that can alter search results
+    uint64_t index_version_ = 0;
+    std::unique_ptr<QueryResultCache> result_cache_;
+    // Set for shards of a ShardedSearchServer: IDF then comes from the whole collection.
+    // Changes in other shards do not bump index_version_, so the result cache stays off
+    const CollectionStatistics* collection_statistics_ = nullptr;
 
     bool IsStopWord(const std::string_view word) const;
 
     static bool IsValidWord(const std::string_view word);
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
+    // Splits text into the caller's buffer, throws on invalid words and drops stop words
+    void SplitIntoWordsNoStop(const std::string_view text, std::vector<std::string_view>& words) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    void Thaw();
+    void DetachFromSnapshot();
+
+    // Makes the frozen index the main segment of a delta segment, if it is not yet
+    void OpenDeltaSegment();
+    void RemoveMainSegmentDocument(int ordinal);
+    // Postings of the live documents, numbered by new_ordinals; ordinals mapped to -1 are left out
+    std::vector<WordPostings> BuildLivePostings(const std::vector<int>& new_ordinals) const;
+    OrdinalBitmap GetLiveOrdinals() const;
+
+    // Returns the id of the word, adding it to the dictionary and the index if needed
+    TermId FindOrAddTerm(const std::string_view word);
+    void RemoveTermIfUnused(TermId term);
+
+    // Renumbers live documents once removed ones take more than half of the ordinals
+    void CompactOrdinalsIfSparse();
+    // Moves every document to new_ordinals[ordinal] or drops it for -1; kept documents
+    // have to keep their order and get consecutive ordinals from 0
+    void RenumberOrdinals(const std::vector<int>& new_ordinals);
+
+    // Postings of one chunk of a document batch, sorted by word and then by ordinal.
+    // Words are views into the batch texts until the merge adds them to the dictionary
+    struct DocumentBatchChunk {
+        std::map<std::string_view, std::vector<std::pair<int, uint32_t>>> postings;
+        // Indexed by the position of the document in the chunk
+        std::vector<uint32_t> word_counts;
+        std::exception_ptr error;
+    };
+
+    // Validates ids and prepares the index for the batch
+    void BeginDocumentBatch(const std::vector<NewDocument>& documents);
+    void TokenizeDocumentBatch(const std::vector<NewDocument>& documents, size_t first_document,
+        size_t last_document, DocumentBatchChunk& chunk) const;
+    void FinishDocumentBatch(const std::vector<NewDocument>& documents, std::vector<DocumentBatchChunk>& chunks);
+
+    // Throws std::out_of_range for unknown ids
+    int GetOrdinal(int document_id) const;
+    // Returns -1 for unknown ids
+    int FindOrdinal(int document_id) const;
+
+    MappedArray<TermCount> GetDocumentTermCounts(int ordinal) const;
+
+    bool HasDocumentWithTerm(TermId term, int ordinal) const;
+
+    // Calls function(ordinal, term_freq) for postings of the term with ordinals in [first_ordinal, last_ordinal)
+    template <typename Function>
+    void ForEachPosting(TermId term, int first_ordinal, int last_ordinal, Function function) const;
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
@@ -88,28 +293,151 @@ private:
     };
 
     QueryWord ParseQueryWord(const std::string_view text) const;
+    [[noreturn]] static void ThrowInvalidQueryWord(const std::string_view text);
 
+    // Words are resolved to term ids once; words missing from the dictionary
+    // cannot match any document and are dropped
     struct Query {
-        std::vector<std::string> plus_words;
-        std::vector<std::string> minus_words;
+        std::vector<TermId> plus_terms;
+        std::vector<TermId> minus_terms;
     };
 
     Query ParseQuery(const std::string_view text) const;
     Query ParseQuery(const std::execution::parallel_policy, const std::string_view& text) const;
+    void ParseQuery(const std::string_view text, std::vector<std::string_view>& words, Query& result) const;
 
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    void UpdateLogDocumentCount();
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query,
-        DocumentPredicate document_predicate) const;
+    void UpdateLogDocumentFreq(TermId term);
+
+    double ComputeTermInverseDocumentFreq(TermId term) const;
+
+    // Status and filter queries go through the result cache, if it is enabled
+    template <typename ExePolicy>
+    const std::vector<Document>& FindTopDocumentsWithFilter(const ExePolicy& policy, QueryContext& context,
+        const std::string_view raw_query, const DocumentFilter& filter, size_t top_count) const;
+
+    // Scores documents matching context.query_ and leaves the best top_count in context.results_.
+    // Only documents in ordinal_filter, unless it is null, and accepted by the predicate are scored
     template <typename ExePolicy, typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const ExePolicy& policy, const Query& query,
-        DocumentPredicate document_predicate) const;
+    void FindAllDocuments(const ExePolicy& policy, QueryContext& context, const OrdinalBitmap* ordinal_filter,
+        DocumentPredicate document_predicate, size_t top_count) const;
+
+    // Splits ordinals of the index into shard_count ranges for context.query_ and
+    // computes everything the shards share
+    void PrepareShards(QueryContext& context, size_t shard_count) const;
+
+    // Scores documents of one ordinal range into context.heaps_[shard]
+    template <typename DocumentPredicate>
+    void FindShardDocuments(QueryContext& context, size_t shard, const OrdinalBitmap* ordinal_filter,
+        DocumentPredicate document_predicate, size_t top_count) const;
+
+    // Ranks the documents of one of part_count ordinal ranges that pass the filter,
+    // so that parts of one query can run on different threads with their own contexts.
+    // Results of the part are left in context.results_, the result cache is not used
+    const std::vector<Document>& FindTopDocumentsPart(QueryContext& context, const std::string_view raw_query,
+        const DocumentFilter& filter, size_t part, size_t part_count, size_t top_count) const;
+
+    // Score bounds of the frozen index do not cover a delta segment
+    bool UsesMaxScore() const;
+
+    // Orders plus terms of context.query_ by their score bounds in the frozen index
+    void PrepareMaxScore(QueryContext& context, size_t shard_count) const;
+
+    // Document-at-a-time MaxScore over the frozen index: documents whose score bound
+    // cannot outrank the weakest kept document are skipped without being scored
+    template <typename DocumentPredicate>
+    void FindShardDocumentsMaxScore(QueryContext& context, size_t shard, int first_ordinal, int last_ordinal,
+        const OrdinalBitmap* ordinal_filter, DocumentPredicate document_predicate, TopDocumentsHeap& heap) const;
 
 
 
 };
 
+// Reads the id set of the server or, while it is a snapshot view, its sorted ids column
+class SearchServer::DocumentIdIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = int;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const int*;
+    using reference = const int&;
+
+    DocumentIdIterator() = default;
+
+    reference operator*() const {
+        return column_id_ != nullptr ? *column_id_ : *set_id_;
+    }
+
+    pointer operator->() const {
+        return &**this;
+    }
+
+    DocumentIdIterator& operator++() {
+        if (column_id_ != nullptr) {
+            ++column_id_;
+        }
+        else {
+            ++set_id_;
+        }
+        return *this;
+    }
+
+    DocumentIdIterator operator++(int) {
+        DocumentIdIterator old = *this;
+        ++*this;
+        return old;
+    }
+
+    bool operator==(const DocumentIdIterator& other) const {
+        return column_id_ == other.column_id_ && set_id_ == other.set_id_;
+    }
+
+    bool operator!=(const DocumentIdIterator& other) const {
+        return !(*this == other);
+    }
+
+private:
+    friend class SearchServer;
+
+    std::set<int>::const_iterator set_id_;
+    const int* column_id_ = nullptr;
+};
+
+class SearchServer::QueryContext {
+public:
+    QueryContext() = default;
+
+private:
+    friend class SearchServer;
+
+    std::vector<std::string_view> words_;
+    Query query_;
+    std::vector<double> inverse_document_freqs_;
+    std::vector<size_t> shards_;
+    RelevanceAccumulator accumulator_;
+    std::vector<TopDocumentsHeap> heaps_;
+    std::vector<Document> results_;
+    // MaxScore state: plus term indexes by ascending score bound, the bounds in that
+    // order with their prefix sums and the inverse permutation
+    std::vector<size_t> term_order_;
+    std::vector<double> term_bounds_;
+    std::vector<double> term_bound_sums_;
+    std::vector<size_t> term_positions_;
+
+    // Essential terms are accumulated a window of ordinals at a time
+    static const int MAX_SCORE_WINDOW_SIZE = 2048;
+
+    struct MaxScoreShard {
+        std::vector<FrozenIndex::Cursor> scanners;
+        std::vector<FrozenIndex::Cursor> probes;
+        std::vector<double> scores;
+        std::vector<uint64_t> matches;
+        std::vector<uint64_t> rejections;
+    };
+    std::vector<MaxScoreShard> max_score_shards_;
+};
+
 
 
 
@@ -122,11 +450,36 @@ SearchServer::SearchServer(const StringContainer& stop_words)
 {
     using namespace std;
 
-    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+    if (!all_of(stop_words_.GetWords().begin(), stop_words_.GetWords().end(), IsValidWord)) {
         throw std::invalid_argument("Some of stop words are invalid"s);
     }
 }
 
+template <typename ExePolicy>
+void SearchServer::AddDocuments(const ExePolicy& policy, const std::vector<NewDocument>& documents) {
+
+    if (documents.empty()) {
+        return;
+    }
+    BeginDocumentBatch(documents);
+
+    const size_t chunk_count = std::min(documents.size(),
+        std::is_same_v<std::decay_t<ExePolicy>, std::execution::sequenced_policy>
+        ? size_t{ 1 }
+        : std::max<size_t>(1, std::thread::hardware_concurrency()));
+    const size_t chunk_size = (documents.size() + chunk_count - 1) / chunk_count;
+
+    std::vector<DocumentBatchChunk> chunks(chunk_count);
+    std::vector<size_t> chunk_indexes(chunk_count);
+    std::iota(chunk_indexes.begin(), chunk_indexes.end(), 0);
+    std::for_each(policy, chunk_indexes.begin(), chunk_indexes.end(), [&](size_t chunk) {
+        TokenizeDocumentBatch(documents, std::min(documents.size(), chunk * chunk_size),
+            std::min(documents.size(), (chunk + 1) * chunk_size), chunks[chunk]);
+    });
+
+    FinishDocumentBatch(documents, chunks);
+}
+
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query,
     DocumentPredicate document_predicate) const {
@@ -136,54 +489,63 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_
 template <typename DocumentPredicate, typename ExePolicy>
 std::vector<Document> SearchServer::FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query,
     DocumentPredicate document_predicate) const {
+    return FindTopDocuments(policy, raw_query, document_predicate, MAX_RESULT_DOCUMENT_COUNT);
+}
 
-    auto query = ParseQuery(std::execution::par, raw_query);
+template <typename DocumentPredicate, typename ExePolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t top_count) const {
 
-    std::sort(
-        policy,
-        query.minus_words.begin(),
-        query.minus_words.end()
-    );
-    query.minus_words.erase(
-        std::unique(policy, query.minus_words.begin(), query.minus_words.end()),
-        query.minus_words.end()
-    );
+    QueryContext context;
+    FindTopDocuments(policy, context, raw_query, document_predicate, top_count);
+    return std::move(context.results_);
+}
+template<typename ExePolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query,
+    DocumentStatus status, size_t top_count) const {
 
-    std::sort(
-        policy,
-        query.plus_words.begin(),
-        query.plus_words.end()
-    );
-    query.plus_words.erase(
-        std::unique(policy, query.plus_words.begin(), query.plus_words.end()),
-        query.plus_words.end()
-    );
+    return FindTopDocuments(policy, raw_query, DocumentFilter{ status }, top_count);
+}
+template<typename ExePolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query,
+    const DocumentFilter& filter, size_t top_count) const {
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+    QueryContext context;
+    FindTopDocumentsWithFilter(policy, context, raw_query, filter, top_count);
+    return std::move(context.results_);
+}
 
-    std::sort(
-        policy,
-        matched_documents.begin(),
-        matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            return std::abs(lhs.relevance - rhs.relevance) < EPSILON
-                ? lhs.rating > rhs.rating
-                : lhs.relevance > rhs.relevance;
-        }
-    );
+template <typename DocumentPredicate, typename ExePolicy>
+std::vector<Document> SearchServer::FindTopDocumentsPage(const ExePolicy& policy, const std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t offset, size_t limit) const {
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    if (limit == 0) {
+        return {};
     }
+    // Saturated, so a huge limit does not wrap around to a short page
+    const size_t top_count = limit <= std::numeric_limits<size_t>::max() - offset
+        ? offset + limit : std::numeric_limits<size_t>::max();
+    auto documents = FindTopDocuments(policy, raw_query, document_predicate, top_count);
+    documents.erase(documents.begin(), documents.begin() + std::min(offset, documents.size()));
+    return documents;
+}
+template<typename ExePolicy>
+std::vector<Document> SearchServer::FindTopDocumentsPage(const ExePolicy& policy, const std::string_view raw_query,
+    DocumentStatus status, size_t offset, size_t limit) const {
 
-    return matched_documents;
-
+    if (limit == 0) {
+        return {};
+    }
+    // Saturated, so a huge limit does not wrap around to a short page
+    const size_t top_count = limit <= std::numeric_limits<size_t>::max() - offset
+        ? offset + limit : std::numeric_limits<size_t>::max();
+    auto documents = FindTopDocuments(policy, raw_query, status, top_count);
+    documents.erase(documents.begin(), documents.begin() + std::min(offset, documents.size()));
+    return documents;
 }
 template<typename ExePolicy>
 std::vector<Document> SearchServer::FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;});
-
+    return FindTopDocuments(policy, raw_query, status, MAX_RESULT_DOCUMENT_COUNT);
 }
 template<typename ExePolicy>
 std::vector<Document> SearchServer::FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query) const {
@@ -191,72 +553,273 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExePolicy& policy, co
 }
 
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query,
-    DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
+template <typename DocumentPredicate, typename ExePolicy>
+const std::vector<Document>& SearchServer::FindTopDocuments(const ExePolicy& policy, QueryContext& context,
+    const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count) const {
+
+    ParseQuery(raw_query, context.words_, context.query_);
+    FindAllDocuments(policy, context, nullptr, document_predicate, top_count);
+    return context.results_;
+}
+
+template <typename ExePolicy>
+const std::vector<Document>& SearchServer::FindTopDocumentsWithFilter(const ExePolicy& policy, QueryContext& context,
+    const std::string_view raw_query, const DocumentFilter& filter, size_t top_count) const {
+
+    ParseQuery(raw_query, context.words_, context.query_);
+
+    std::optional<QueryResultCache::Key> key;
+    if (result_cache_) {
+        key = QueryResultCache::Key{ context.query_.plus_terms, context.query_.minus_terms, filter, top_count };
+        if (result_cache_->Find(*key, index_version_, context.results_)) {
+            return context.results_;
+        }
+    }
+
+    const int min_rating = filter.min_rating;
+    const int max_rating = filter.max_rating;
+    FindAllDocuments(policy, context, &documents_.status_ordinals[static_cast<int>(filter.status)],
+        [min_rating, max_rating](int, DocumentStatus, int rating) {
+            return min_rating <= rating && rating <= max_rating;
+        }, top_count);
+
+    if (result_cache_) {
+        result_cache_->Insert(std::move(*key), index_version_, context.results_);
+    }
+    return context.results_;
 }
 
 template <typename ExePolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const ExePolicy& policy, const Query& query,
-    DocumentPredicate document_predicate) const {
+void SearchServer::FindAllDocuments(const ExePolicy& policy, QueryContext& context, const OrdinalBitmap* ordinal_filter,
+    DocumentPredicate document_predicate, size_t top_count) const {
+
+    // Every shard owns a contiguous range of ordinals and walks only its part of each
+    // posting list, so parallel workers never contend for the same accumulator slots
+    const size_t shard_count = std::is_same_v<std::decay_t<ExePolicy>, std::execution::sequenced_policy>
+        ? 1
+        : std::thread::hardware_concurrency();
 
-    ConcurrentMap<int, double> document_to_relevance(150);
+    PrepareShards(context, shard_count);
+    auto& shards = context.shards_;
 
     std::for_each(
         policy,
-        query.plus_words.begin(),
-        query.plus_words.end(),
-        [&](const std::string_view& word) {
-            if (word_to_id_freqs_.count(word) == 0) {
-                return;
-            }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            std::for_each(
-                policy,
-                word_to_id_freqs_.at(word).begin(),
-                word_to_id_freqs_.at(word).end(),
-                [&](const auto& document) {
-                    const auto& document_data = documents_.at(document.first);
-                    if (document_predicate(document.first, document_data.status, document_data.rating)) {
-                        document_to_relevance[document.first].ref_to_value += document.second * inverse_document_freq;
+        shards.begin(),
+        shards.end(),
+        [&](size_t shard) {
+            FindShardDocuments(context, shard, ordinal_filter, document_predicate, top_count);
+        }
+    );
+
+    PROFILE_QUERY_STAGE(QueryStage::RESULT_BUILD);
+    for (size_t shard = 1; shard < shards.size(); ++shard) {
+        context.heaps_[0].Merge(context.heaps_[shard]);
+    }
+    context.heaps_[0].ExtractTo(context.results_);
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindShardDocuments(QueryContext& context, size_t shard, const OrdinalBitmap* ordinal_filter,
+    DocumentPredicate document_predicate, size_t top_count) const {
+
+    const Query& query = context.query_;
+    RelevanceAccumulator& accumulator = context.accumulator_;
+    const auto& inverse_document_freqs = context.inverse_document_freqs_;
+    const int first_ordinal = accumulator.GetShardBegin(shard);
+    const int last_ordinal = accumulator.GetShardEnd(shard);
+
+    // Every shard keeps its own top-K, the partial heaps are merged by the caller
+    TopDocumentsHeap& heap = context.heaps_[shard];
+    heap.Reset(top_count);
+
+    if (UsesMaxScore()) {
+        // Minus words and ranking are interleaved with posting traversal here
+        PROFILE_QUERY_STAGE(QueryStage::POSTINGS);
+        FindShardDocumentsMaxScore(context, shard, first_ordinal, last_ordinal, ordinal_filter,
+            document_predicate, heap);
+        return;
+    }
+
+    // Documents with minus words are marked first, so they are never scored
+    {
+        PROFILE_QUERY_STAGE(QueryStage::MINUS_FILTER);
+        for (const TermId term : query.minus_terms) {
+            ForEachPosting(
+                term,
+                first_ordinal,
+                last_ordinal,
+                [&](int ordinal, double) {
+                    accumulator.Exclude(shard, ordinal);
+                }
+            );
+        }
+    }
+    {
+        PROFILE_QUERY_STAGE(QueryStage::POSTINGS);
+        for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+            ForEachPosting(
+                query.plus_terms[i],
+                first_ordinal,
+                last_ordinal,
+                [&](int ordinal, double term_freq) {
+                    if (!accumulator.IsExcluded(ordinal)
+                        && (ordinal_filter == nullptr || ordinal_filter->Contains(ordinal))
+                        && document_predicate(documents_.ids[ordinal], documents_.statuses[ordinal], documents_.ratings[ordinal])) {
+                        accumulator.Add(shard, ordinal, term_freq * inverse_document_freqs[i]);
                     }
                 }
             );
         }
-    );
-    std::for_each(
-        policy,
-        query.minus_words.begin(),
-        query.minus_words.end(),
-        [&](const std::string_view word) {
-            if (word_to_id_freqs_.count(word) == 0) {
-                return;
+    }
+
+    PROFILE_QUERY_STAGE(QueryStage::RANKING);
+    accumulator.ForEachMatched(shard, [&](int ordinal, double relevance) {
+        heap.Push({ documents_.ids[ordinal], relevance, documents_.ratings[ordinal] });
+    });
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindShardDocumentsMaxScore(QueryContext& context, size_t shard, int first_ordinal,
+    int last_ordinal, const OrdinalBitmap* ordinal_filter, DocumentPredicate document_predicate,
+    TopDocumentsHeap& heap) const {
+
+    // Bounds are sums taken in another order than the scores, so they may be off by a few ulps
+    const double BOUND_TOLERANCE = 1e-9;
+    const int WINDOW_SIZE = QueryContext::MAX_SCORE_WINDOW_SIZE;
+
+    const Query& query = context.query_;
+    const size_t term_count = query.plus_terms.size();
+    const auto& inverse_document_freqs = context.inverse_document_freqs_;
+    const auto& term_order = context.term_order_;
+    const auto& term_bounds = context.term_bounds_;
+    const auto& term_bound_sums = context.term_bound_sums_;
+    const auto& term_positions = context.term_positions_;
+
+    // Scanners walk essential plus terms in bound order followed by minus terms.
+    // Probes visit single candidates for plus terms, in the same order
+    auto& state = context.max_score_shards_[shard];
+    state.scanners.clear();
+    state.probes.clear();
+    for (const size_t i : term_order) {
+        state.scanners.push_back(frozen_index_->GetCursor(query.plus_terms[i], first_ordinal));
+    }
+    state.probes = state.scanners;
+    for (const TermId term : query.minus_terms) {
+        state.scanners.push_back(frozen_index_->GetCursor(term, first_ordinal));
+    }
+    state.scores.assign(WINDOW_SIZE, 0.0);
+    state.matches.assign(WINDOW_SIZE / 64, 0);
+    state.rejections.assign(WINDOW_SIZE / 64, 0);
+
+    // A document has to score at least threshold to outrank the weakest kept one. Terms
+    // before first_essential cannot reach it together, so only documents containing
+    // one of the remaining terms are candidates
+    double threshold = -std::numeric_limits<double>::infinity();
+    size_t first_essential = 0;
+    const bool has_rejections = ordinal_filter != nullptr || !query.minus_terms.empty();
+
+    for (int window_begin = first_ordinal; window_begin < last_ordinal; window_begin += WINDOW_SIZE) {
+        const int window_end = std::min(last_ordinal, window_begin + WINDOW_SIZE);
+
+        // Documents outside the filter or with minus words are marked first, so they are never scored
+        if (ordinal_filter != nullptr) {
+            for (size_t word = 0; word < state.rejections.size(); ++word) {
+                state.rejections[word] = ~ordinal_filter->GetBits(window_begin + static_cast<int>(word * 64));
             }
-            for (const auto [document_id, _] : word_to_id_freqs_.at(word)) {
-                document_to_relevance.erase(document_id);
+        }
+        for (size_t j = term_count; j < state.scanners.size(); ++j) {
+            for (FrozenIndex::Cursor& scanner = state.scanners[j]; scanner.GetOrdinal() < window_end; scanner.Next()) {
+                const int offset = scanner.GetOrdinal() - window_begin;
+                state.rejections[offset / 64] |= uint64_t{ 1 } << (offset % 64);
             }
         }
-    );
 
-    const auto builded = std::move(document_to_relevance.BuildOrdinaryMap());
-    std::vector<Document> matched_documents;
-    matched_documents.reserve(builded.size());
-    std::mutex locker;
+        const size_t window_essential = first_essential;
+        for (size_t j = window_essential; j < term_count; ++j) {
+            FrozenIndex::Cursor& scanner = state.scanners[j];
+            const double inverse_document_freq = inverse_document_freqs[term_order[j]];
+            for (; scanner.GetOrdinal() < window_end; scanner.Next()) {
+                const int offset = scanner.GetOrdinal() - window_begin;
+                if (has_rejections && ((state.rejections[offset / 64] >> (offset % 64)) & 1)) {
+                    continue;
+                }
+                state.scores[offset] += scanner.GetTermFreq() * inverse_document_freq;
+                state.matches[offset / 64] |= uint64_t{ 1 } << (offset % 64);
+            }
+        }
+        const double window_base = window_essential > 0 ? term_bound_sums[window_essential - 1] : 0.0;
+
+        for (size_t word = 0; word < state.matches.size(); ++word) {
+            for (uint64_t bits = state.matches[word]; bits != 0; bits &= bits - 1) {
+                const int offset = static_cast<int>(word * 64) + __builtin_ctzll(bits);
+                const int ordinal = window_begin + offset;
+                double bound = window_base + state.scores[offset];
+                state.scores[offset] = 0.0;
+
+                bool is_candidate = bound >= threshold
+                    && document_predicate(documents_.ids[ordinal], documents_.statuses[ordinal], documents_.ratings[ordinal]);
+                // Non-essential terms replace their bounds with actual contributions, largest first
+                for (size_t j = window_essential; is_candidate && j-- > 0;) {
+                    state.probes[j].SkipTo(ordinal);
+                    bound -= term_bounds[j];
+                    if (state.probes[j].GetOrdinal() == ordinal) {
+                        bound += state.probes[j].GetTermFreq() * inverse_document_freqs[term_order[j]];
+                    }
+                    is_candidate = bound >= threshold;
+                }
+                if (!is_candidate) {
+                    continue;
+                }
 
-    std::for_each(
-        policy,
-        builded.begin(),
-        builded.end(),
-        [&](const auto& content) {
-            Document* ptr;
-            {
-                std::lock_guard g(locker);
-                ptr = &matched_documents.emplace_back();
+                // Summed in query order, exactly as the term-at-a-time path does
+                double relevance = 0.0;
+                for (size_t i = 0; i < term_count; ++i) {
+                    FrozenIndex::Cursor& probe = state.probes[term_positions[i]];
+                    probe.SkipTo(ordinal);
+                    if (probe.GetOrdinal() == ordinal) {
+                        relevance += probe.GetTermFreq() * inverse_document_freqs[i];
+                    }
+                }
+                heap.Push({ documents_.ids[ordinal], relevance, documents_.ratings[ordinal] });
+
+                // Documents within EPSILON of the weakest one may still outrank it by rating
+                if (heap.IsFull()) {
+                    threshold = std::max(threshold, heap.GetWeakest().relevance - EPSILON - BOUND_TOLERANCE);
+                    while (first_essential < term_count && term_bound_sums[first_essential] < threshold) {
+                        ++first_essential;
+                    }
+                }
             }
-            *ptr = { content.first, content.second, documents_.at(content.first).rating };
+            state.matches[word] = 0;
+            state.rejections[word] = 0;
         }
-    );
+    }
+}
+
+template <typename Function>
+void SearchServer::ForEachPosting(TermId term, int first_ordinal, int last_ordinal,
+    Function function) const {
+
+    if (frozen_index_ && !has_delta_segment_) {
+        frozen_index_->ForEachPosting(term, first_ordinal, last_ordinal, function);
+        return;
+    }
+    if (frozen_index_) {
+        frozen_index_->ForEachPosting(term, first_ordinal, std::min(last_ordinal, main_ordinal_count_),
+            [&](int ordinal, double term_freq) {
+                if (!tombstones_.Contains(ordinal)) {
+                    function(ordinal, term_freq);
+                }
+            });
+        first_ordinal = std::max(first_ordinal, main_ordinal_count_);
+        if (first_ordinal >= last_ordinal) {
+            return;
+        }
+    }
 
-    return matched_documents;
+    const auto& ordinal_freqs = term_postings_[term].ordinal_freqs;
+    const auto last = ordinal_freqs.lower_bound(last_ordinal);
+    for (auto document = ordinal_freqs.lower_bound(first_ordinal); document != last; ++document) {
+        function(document->first, document->second);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "sharded_search_server.h"
+
+void ShardedSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status,
+    const std::vector<int>& ratings) {
+
+    SearchServer& shard = GetShard(document_id);
+    shard.AddDocument(document_id, document, status, ratings);
+    statistics_->AddDocument(GetDocumentWords(shard, document_id));
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+
+    SearchServer& shard = GetShard(document_id);
+    if (shard.FindOrdinal(document_id) < 0) {
+        return;
+    }
+    // Words refer to the shard's dictionary, so they are counted out before the shard drops them
+    statistics_->RemoveDocument(GetDocumentWords(shard, document_id));
+    shard.RemoveDocument(document_id);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query,
+    DocumentStatus status) const {
+    return FindTopDocuments(std::execution::par, raw_query, status, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(
+    const std::string_view raw_query, int document_id) const {
+    return GetShard(document_id).MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const SearchServer& shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+void ShardedSearchServer::Freeze(PostingFormat format) {
+    for (SearchServer& shard : shards_) {
+        shard.Freeze(format);
+    }
+}
+
+SearchServer& ShardedSearchServer::GetShard(int document_id) {
+    return shards_[static_cast<unsigned>(document_id) % shards_.size()];
+}
+
+const SearchServer& ShardedSearchServer::GetShard(int document_id) const {
+    return shards_[static_cast<unsigned>(document_id) % shards_.size()];
+}
+
+std::vector<std::string_view> ShardedSearchServer::GetDocumentWords(const SearchServer& shard, int document_id) {
+    std::vector<std::string_view> words;
+    for (const auto& [term, count] : shard.GetTermCounts(document_id)) {
+        words.push_back(shard.dictionary_.GetWord(term));
+    }
+    return words;
+}
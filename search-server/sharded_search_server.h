@@ -0,0 +1,149 @@
+#pragma once
+#include "collection_statistics.h"
+#include "document.h"
+#include "search_server.h"
+#include "top_documents.h"
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <execution>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+// Front-end over independent SearchServer shards, each owning the documents whose
+// ids map to it. Queries run in all shards at once and the per-shard top documents
+// are merged. Shards rank with document frequencies of the whole collection, so
+// results are the ones a single SearchServer with all documents would return
+class ShardedSearchServer {
+public:
+    template <typename StopWords>
+    explicit ShardedSearchServer(const StopWords& stop_words,
+        size_t shard_count = std::max(1u, std::thread::hardware_concurrency()));
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status,
+        const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    // Shards are searched in parallel
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query,
+        DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    // The policy decides whether shards are searched one after another or in parallel
+    template <typename ExePolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query,
+        DocumentPredicate document_predicate, size_t top_count) const;
+    template <typename ExePolicy>
+    std::vector<Document> FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query,
+        DocumentStatus status, size_t top_count) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query,
+        int document_id) const;
+
+    int GetDocumentCount() const;
+    size_t GetShardCount() const;
+
+    void Freeze(PostingFormat format = PostingFormat::PLAIN);
+
+private:
+    // Owned through a pointer, so shards keep a valid address when the front-end moves
+    std::unique_ptr<CollectionStatistics> statistics_;
+    std::vector<SearchServer> shards_;
+
+    SearchServer& GetShard(int document_id);
+    const SearchServer& GetShard(int document_id) const;
+
+    static std::vector<std::string_view> GetDocumentWords(const SearchServer& shard, int document_id);
+
+    // Merges search(shard) of every shard; the first error of a shard is rethrown
+    template <typename ExePolicy, typename ShardSearch>
+    std::vector<Document> FindTopDocumentsInShards(const ExePolicy& policy, ShardSearch search,
+        size_t top_count) const;
+};
+
+
+//TEMPLATES --------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+template <typename StopWords>
+ShardedSearchServer::ShardedSearchServer(const StopWords& stop_words, size_t shard_count)
+    : statistics_(std::make_unique<CollectionStatistics>())
+{
+    using namespace std;
+
+    if (shard_count == 0) {
+        throw invalid_argument("Shard count must be positive"s);
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words);
+        shards_.back().collection_statistics_ = statistics_.get();
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query,
+    DocumentPredicate document_predicate) const {
+    return FindTopDocuments(std::execution::par, raw_query, document_predicate, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+template <typename ExePolicy, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t top_count) const {
+
+    return FindTopDocumentsInShards(policy, [&](const SearchServer& shard) {
+        return shard.FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_count);
+    }, top_count);
+}
+
+template <typename ExePolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExePolicy& policy, const std::string_view raw_query,
+    DocumentStatus status, size_t top_count) const {
+
+    return FindTopDocumentsInShards(policy, [&](const SearchServer& shard) {
+        return shard.FindTopDocuments(std::execution::seq, raw_query, DocumentFilter{ status }, top_count);
+    }, top_count);
+}
+
+template <typename ExePolicy, typename ShardSearch>
+std::vector<Document> ShardedSearchServer::FindTopDocumentsInShards(const ExePolicy& policy, ShardSearch search,
+    size_t top_count) const {
+
+    // Parallel algorithms terminate on exceptions, so errors are carried out explicitly
+    struct ShardResult {
+        std::vector<Document> documents;
+        std::exception_ptr error;
+    };
+    std::vector<ShardResult> results(shards_.size());
+    std::vector<size_t> shard_indexes(shards_.size());
+    std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    std::for_each(policy, shard_indexes.begin(), shard_indexes.end(), [&](size_t shard) {
+        try {
+            results[shard].documents = search(shards_[shard]);
+        }
+        catch (...) {
+            results[shard].error = std::current_exception();
+        }
+    });
+
+    TopDocumentsHeap heap(top_count);
+    for (const ShardResult& result : results) {
+        if (result.error) {
+            std::rethrow_exception(result.error);
+        }
+        for (const Document& document : result.documents) {
+            heap.Push(document);
+        }
+    }
+    std::vector<Document> documents;
+    heap.ExtractTo(documents);
+    return documents;
+}
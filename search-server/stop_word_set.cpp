@@ -0,0 +1,38 @@
+#include "stop_word_set.h"
+
+StopWordSet::StopWordSet(const std::set<std::string, std::less<>>& words) {
+
+    words_.reserve(words.size());
+    hashes_.reserve(words.size());
+
+    size_t slot_count = 1;
+    while (slot_count < 2 * words.size()) {
+        slot_count *= 2;
+    }
+    slots_.assign(words.empty() ? 0 : slot_count, EMPTY_SLOT);
+
+    for (const std::string& word : words) {
+        if (word.empty()) {
+            continue;
+        }
+        const uint32_t word_index = static_cast<uint32_t>(words_.size());
+        words_.push_back(word);
+        hashes_.push_back(Hash(word));
+
+        if (word.size() < 64) {
+            length_mask_ |= uint64_t{ 1 } << word.size();
+        }
+        const unsigned char first_char = static_cast<unsigned char>(word[0]);
+        first_chars_[first_char / 64] |= uint64_t{ 1 } << (first_char % 64);
+
+        size_t slot = hashes_.back() & (slots_.size() - 1);
+        while (slots_[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & (slots_.size() - 1);
+        }
+        slots_[slot] = word_index;
+    }
+}
+
+const std::vector<std::string>& StopWordSet::GetWords() const {
+    return words_;
+}
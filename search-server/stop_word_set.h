@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable set of stop words built once with the server. Lookups go through
+// a length and first-character prefilter, so most ordinary words are rejected
+// without hashing, and then probe an open-addressing table.
+class StopWordSet {
+public:
+    StopWordSet() = default;
+
+    explicit StopWordSet(const std::set<std::string, std::less<>>& words);
+
+    bool Contains(std::string_view word) const {
+        if (word.empty()
+            || (word.size() < 64 && (length_mask_ >> word.size() & 1) == 0)
+            || (first_chars_[static_cast<unsigned char>(word[0]) / 64] >> (static_cast<unsigned char>(word[0]) % 64) & 1) == 0) {
+            return false;
+        }
+        if (slots_.empty()) {
+            return false;
+        }
+        const uint64_t hash = Hash(word);
+        for (size_t slot = hash & (slots_.size() - 1); slots_[slot] != EMPTY_SLOT; slot = (slot + 1) & (slots_.size() - 1)) {
+            const uint32_t word_index = slots_[slot];
+            if (hashes_[word_index] == hash && words_[word_index] == word) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Sorted words
+    const std::vector<std::string>& GetWords() const;
+
+private:
+    static constexpr uint32_t EMPTY_SLOT = static_cast<uint32_t>(-1);
+
+    std::vector<std::string> words_;
+    std::vector<uint64_t> hashes_;
+    std::vector<uint32_t> slots_;
+    // Bit n is set if some stop word has length n; lengths of 64 and more always pass
+    uint64_t length_mask_ = 0;
+    uint64_t first_chars_[4] = {};
+
+    static uint64_t Hash(std::string_view word) {
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for (const char c : word) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        return hash;
+    }
+};
@@ -1,15 +1,184 @@
 #include "string_processing.h"
+#include <algorithm>
+#include <cstdint>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SEARCH_SERVER_SSE2 1
+#include <emmintrin.h>
+#endif
 
-std::vector<std::string_view> SplitIntoWords(const std::string_view text) {
-    std::vector<std::string_view> words;
+#if defined(SEARCH_SERVER_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define SEARCH_SERVER_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const size_t npos = std::string_view::npos;
+
+inline int CountTrailingZeros(uint64_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+#else
+    int count = 0;
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+// Turns per-byte masks of consecutive chunks into words. Bit i of a mask describes
+// byte offset + i; the masks of one chunk cover width bytes
+class WordScanner {
+public:
+    WordScanner(const std::string_view text, std::vector<std::string_view>& words)
+        : text_(text)
+        , words_(words)
+    {
+        words_.clear();
+    }
+
+    void Consume(size_t offset, size_t width, uint64_t space_mask, uint64_t control_mask) {
+        if (control_mask != 0 && first_control_ == npos) {
+            first_control_ = offset + CountTrailingZeros(control_mask);
+        }
 
-    size_t start = text.find_first_not_of(' ');
-    while (start != std::string_view::npos) {
-        size_t end = text.find(' ', start);
-        words.push_back(text.substr(start, end - start));
-        start = text.find_first_not_of(' ', end);
+        uint64_t pending = width == 64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << width) - 1;
+        while (true) {
+            // Looking for the start of a word outside one, for its end inside one
+            const uint64_t boundaries = (word_start_ == npos ? ~space_mask : space_mask) & pending;
+            if (boundaries == 0) {
+                return;
+            }
+            const int bit = CountTrailingZeros(boundaries);
+            if (word_start_ == npos) {
+                word_start_ = offset + bit;
+            }
+            else {
+                words_.push_back(text_.substr(word_start_, offset + bit - word_start_));
+                word_start_ = npos;
+            }
+            pending &= ~((uint64_t{ 2 } << bit) - 1);
+        }
     }
+
+    size_t Finish() {
+        if (word_start_ != npos) {
+            words_.push_back(text_.substr(word_start_));
+        }
+        if (first_control_ == npos) {
+            return npos;
+        }
+        // Control characters are never spaces, so the byte belongs to a word
+        size_t word = 0;
+        while (words_[word].data() + words_[word].size() <= text_.data() + first_control_) {
+            ++word;
+        }
+        return word;
+    }
+
+private:
+    std::string_view text_;
+    std::vector<std::string_view>& words_;
+    size_t word_start_ = npos;
+    size_t first_control_ = npos;
+};
+
+inline bool IsControlChar(char c) {
+    return c >= '\0' && c < ' ';
+}
+
+void ConsumeScalar(WordScanner& scanner, const std::string_view text, size_t offset) {
+    while (offset < text.size()) {
+        const size_t width = std::min<size_t>(64, text.size() - offset);
+        uint64_t space_mask = 0;
+        uint64_t control_mask = 0;
+        for (size_t i = 0; i < width; ++i) {
+            space_mask |= uint64_t{ text[offset + i] == ' ' } << i;
+            control_mask |= uint64_t{ IsControlChar(text[offset + i]) } << i;
+        }
+        scanner.Consume(offset, width, space_mask, control_mask);
+        offset += width;
+    }
+}
+
+#ifndef SEARCH_SERVER_SSE2
+size_t TokenizeScalar(const std::string_view text, std::vector<std::string_view>& words) {
+    WordScanner scanner(text, words);
+    ConsumeScalar(scanner, text, 0);
+    return scanner.Finish();
+}
+#endif
+
+#ifdef SEARCH_SERVER_SSE2
+size_t TokenizeSse2(const std::string_view text, std::vector<std::string_view>& words) {
+    WordScanner scanner(text, words);
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i minus_one = _mm_set1_epi8(-1);
+
+    size_t offset = 0;
+    for (; offset + 16 <= text.size(); offset += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + offset));
+        const __m128i controls = _mm_and_si128(_mm_cmplt_epi8(chunk, spaces), _mm_cmpgt_epi8(chunk, minus_one));
+        scanner.Consume(offset, 16,
+            static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, spaces))),
+            static_cast<uint32_t>(_mm_movemask_epi8(controls)));
+    }
+    ConsumeScalar(scanner, text, offset);
+    return scanner.Finish();
+}
+#endif
+
+#ifdef SEARCH_SERVER_AVX2
+__attribute__((target("avx2")))
+size_t TokenizeAvx2(const std::string_view text, std::vector<std::string_view>& words) {
+    WordScanner scanner(text, words);
+    const __m256i spaces = _mm256_set1_epi8(' ');
+    const __m256i minus_one = _mm256_set1_epi8(-1);
+
+    size_t offset = 0;
+    for (; offset + 32 <= text.size(); offset += 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + offset));
+        const __m256i controls = _mm256_and_si256(_mm256_cmpgt_epi8(spaces, chunk), _mm256_cmpgt_epi8(chunk, minus_one));
+        scanner.Consume(offset, 32,
+            static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, spaces))),
+            static_cast<uint32_t>(_mm256_movemask_epi8(controls)));
+    }
+    ConsumeScalar(scanner, text, offset);
+    return scanner.Finish();
+}
+#endif
+
+using TokenizeFunction = size_t (*)(const std::string_view, std::vector<std::string_view>&);
+
+TokenizeFunction ChooseTokenizer() {
+#ifdef SEARCH_SERVER_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return TokenizeAvx2;
+    }
+#endif
+#ifdef SEARCH_SERVER_SSE2
+    return TokenizeSse2;
+#else
+    return TokenizeScalar;
+#endif
+}
+
+} // namespace
+
+std::vector<std::string_view> SplitIntoWords(const std::string_view text) {
+    std::vector<std::string_view> words;
+    SplitIntoWords(text, words);
     return words;
+}
+
+void SplitIntoWords(const std::string_view text, std::vector<std::string_view>& words) {
+    TokenizeWords(text, words);
+}
 
+size_t TokenizeWords(const std::string_view text, std::vector<std::string_view>& words) {
+    static const TokenizeFunction tokenize = ChooseTokenizer();
+    return tokenize(text, words);
 }
@@ -1,11 +1,20 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <vector>
 #include <set>
 
 std::vector<std::string_view> SplitIntoWords(const std::string_view text);
 
+// Same as above, but reuses the capacity of the caller's buffer
+void SplitIntoWords(const std::string_view text, std::vector<std::string_view>& words);
+
+// Splits text into the caller's buffer and checks the words for control characters
+// in the same pass, using SSE2 or AVX2 when the CPU has them. Returns the index of
+// the first word with a control character, or std::string_view::npos if there is none
+size_t TokenizeWords(const std::string_view text, std::vector<std::string_view>& words);
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
@@ -0,0 +1,72 @@
+#include "term_dictionary.h"
+
+TermDictionary::TermDictionary(const TermDictionary& other)
+    : words_(other.words_)
+    , storage_(other.storage_)
+    , free_ids_(other.free_ids_)
+{
+    for (TermId term = 0; term < words_.size(); ++term) {
+        if (words_[term].empty()) {
+            continue;
+        }
+        if (words_[term].data() == other.storage_[term].data()) {
+            words_[term] = storage_[term];
+        }
+        ids_.emplace(words_[term], term);
+    }
+}
+
+TermId TermDictionary::Find(std::string_view word) const {
+    const auto it = ids_.find(word);
+    return it == ids_.end() ? NO_TERM : it->second;
+}
+
+TermId TermDictionary::Add(std::string_view word) {
+    return Insert(word, true);
+}
+
+TermId TermDictionary::AddView(std::string_view word) {
+    return Insert(word, false);
+}
+
+void TermDictionary::Remove(TermId term) {
+    ids_.erase(words_[term]);
+    words_[term] = {};
+    storage_[term] = std::string{};
+    free_ids_.push_back(term);
+}
+
+std::string_view TermDictionary::GetWord(TermId term) const {
+    return words_[term];
+}
+
+size_t TermDictionary::GetIdLimit() const {
+    return words_.size();
+}
+
+TermId TermDictionary::Insert(std::string_view word, bool is_copied) {
+
+    const auto it = ids_.find(word);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+
+    TermId term;
+    if (!free_ids_.empty()) {
+        term = free_ids_.back();
+        free_ids_.pop_back();
+    }
+    else {
+        term = static_cast<TermId>(words_.size());
+        words_.emplace_back();
+        storage_.emplace_back();
+    }
+
+    if (is_copied) {
+        storage_[term].assign(word);
+        word = storage_[term];
+    }
+    words_[term] = word;
+    ids_.emplace(word, term);
+    return term;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using TermId = uint32_t;
+
+// Global dictionary of indexed words. Every distinct word gets a compact id once,
+// and the index, the documents and parsed queries refer to words by id only.
+// Ids of removed words are reused, so the dictionary follows the live vocabulary
+class TermDictionary {
+public:
+    static const TermId NO_TERM = static_cast<TermId>(-1);
+
+    TermDictionary() = default;
+
+    // Copied words of a copy refer to its own storage, words added by AddView are shared
+    TermDictionary(const TermDictionary& other);
+    TermDictionary& operator=(const TermDictionary&) = delete;
+    TermDictionary(TermDictionary&&) = default;
+    TermDictionary& operator=(TermDictionary&&) = default;
+
+    // Returns NO_TERM for unknown words
+    TermId Find(std::string_view word) const;
+
+    // Returns the id of the word, copying it into the dictionary if it is new
+    TermId Add(std::string_view word);
+
+    // Same as Add, but a new word is not copied and must outlive the dictionary
+    TermId AddView(std::string_view word);
+
+    // Frees the word's storage: views returned by GetWord for it become invalid,
+    // and its id may be handed to another word
+    void Remove(TermId term);
+
+    std::string_view GetWord(TermId term) const;
+
+    // All ids handed out so far are below this limit
+    size_t GetIdLimit() const;
+
+private:
+    // Indexed by id; storage_ is a deque, so words never move when it grows
+    std::vector<std::string_view> words_;
+    std::deque<std::string> storage_;
+    std::unordered_map<std::string_view, TermId> ids_;
+    std::vector<TermId> free_ids_;
+
+    TermId Insert(std::string_view word, bool is_copied);
+};
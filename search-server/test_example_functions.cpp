@@ -0,0 +1,941 @@
+#include "test_example_functions.h"
+#include "async_search_server.h"
+#include "batch_query_executor.h"
+#include "concurrent_search_server.h"
+#include "process_queries.h"
+#include "query_profiler.h"
+#include "request_queue.h"
+#include "search_server.h"
+#include "sharded_search_server.h"
+#include "stop_word_set.h"
+#include "string_processing.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <execution>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct TestDocument {
+    int id = 0;
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+const std::string TEST_STOP_WORDS = "w0 w1";
+const int TEST_VOCABULARY_SIZE = 60;
+
+// Low word numbers are more frequent, so terms get different IDFs
+std::string GenerateTestText(std::mt19937& generator, int max_word_count) {
+    std::uniform_int_distribution<int> word_distribution(0, TEST_VOCABULARY_SIZE - 1);
+    const int word_count = std::uniform_int_distribution<int>(1, max_word_count)(generator);
+    std::string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        text += "w" + std::to_string(std::min(word_distribution(generator), word_distribution(generator)));
+    }
+    return text;
+}
+
+TestDocument GenerateTestDocument(std::mt19937& generator, int id) {
+    TestDocument document;
+    document.id = id;
+    document.text = GenerateTestText(generator, 12);
+    document.status = std::uniform_int_distribution<int>(0, 3)(generator) == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+    document.ratings = { std::uniform_int_distribution<int>(-5, 10)(generator), std::uniform_int_distribution<int>(-5, 10)(generator) };
+    return document;
+}
+
+std::map<int, TestDocument> GenerateTestCorpus(std::mt19937& generator, int document_count) {
+    std::map<int, TestDocument> documents;
+    for (int id = 0; id < document_count; ++id) {
+        documents[id] = GenerateTestDocument(generator, id);
+    }
+    return documents;
+}
+
+std::vector<std::string> GenerateTestQueries(std::mt19937& generator, int query_count) {
+    std::vector<std::string> queries;
+    for (int i = 0; i < query_count; ++i) {
+        std::string query = GenerateTestText(generator, 4);
+        if (i % 3 == 0) {
+            query += " -w" + std::to_string(std::uniform_int_distribution<int>(2, TEST_VOCABULARY_SIZE - 1)(generator));
+        }
+        queries.push_back(query);
+    }
+    return queries;
+}
+
+SearchServer BuildTestServer(const std::map<int, TestDocument>& documents) {
+    SearchServer search_server(TEST_STOP_WORDS);
+    for (const auto& [id, document] : documents) {
+        search_server.AddDocument(id, document.text, document.status, document.ratings);
+    }
+    return search_server;
+}
+
+void AssertSameDocuments(const std::vector<Document>& lhs, const std::vector<Document>& rhs, double tolerance) {
+    assert(lhs.size() == rhs.size());
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        assert(lhs[i].id == rhs[i].id);
+        assert(lhs[i].rating == rhs[i].rating);
+        assert(std::abs(lhs[i].relevance - rhs[i].relevance) <= tolerance);
+    }
+}
+
+// Same documents and same results of status, predicate and paged queries
+void AssertSameResults(const SearchServer& lhs, const SearchServer& rhs, const std::vector<std::string>& queries,
+    double tolerance) {
+
+    assert(lhs.GetDocumentCount() == rhs.GetDocumentCount());
+    assert(std::vector<int>(lhs.begin(), lhs.end()) == std::vector<int>(rhs.begin(), rhs.end()));
+
+    const auto is_even = [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; };
+    for (const std::string& query : queries) {
+        for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+            AssertSameDocuments(lhs.FindTopDocuments(std::execution::seq, query, status, 20),
+                rhs.FindTopDocuments(std::execution::seq, query, status, 20), tolerance);
+        }
+        AssertSameDocuments(lhs.FindTopDocuments(std::execution::par, query, is_even, 20),
+            rhs.FindTopDocuments(std::execution::par, query, is_even, 20), tolerance);
+        AssertSameDocuments(lhs.FindTopDocumentsPage(std::execution::seq, query, DocumentStatus::ACTUAL, 3, 7),
+            rhs.FindTopDocumentsPage(std::execution::seq, query, DocumentStatus::ACTUAL, 3, 7), tolerance);
+    }
+}
+
+// Splits at spaces one byte at a time, the way the tokenizer worked before SIMD
+size_t TokenizeWordsReference(const std::string_view text, std::vector<std::string_view>& words) {
+    words.clear();
+    size_t invalid_word = std::string_view::npos;
+    size_t word_start = std::string_view::npos;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        if (i == text.size() || text[i] == ' ') {
+            if (word_start != std::string_view::npos) {
+                words.push_back(text.substr(word_start, i - word_start));
+                word_start = std::string_view::npos;
+            }
+            continue;
+        }
+        if (word_start == std::string_view::npos) {
+            word_start = i;
+        }
+        if (text[i] >= '\0' && text[i] < ' ' && invalid_word == std::string_view::npos) {
+            invalid_word = words.size();
+        }
+    }
+    return invalid_word;
+}
+
+// Summation order differs between segments, so relevance may differ in the last bits
+const double REFERENCE_TOLERANCE = 1e-12;
+
+}
+
+void TestTokenizeWords() {
+
+    std::vector<std::string_view> words;
+    std::vector<std::string_view> expected_words;
+    const auto check = [&](const std::string& text) {
+        const size_t expected_invalid_word = TokenizeWordsReference(text, expected_words);
+        assert(TokenizeWords(text, words) == expected_invalid_word);
+        assert(words == expected_words);
+    };
+
+    check("");
+    check("   ");
+    check("cat");
+    check(" cat  dog ");
+
+    // A control character or a word edge on either side of a 16, 32 and 64 byte block
+    for (const size_t length : { 15, 16, 17, 31, 32, 33, 63, 64, 65, 130 }) {
+        for (size_t position = 0; position < length; ++position) {
+            for (const char c : { '\x01', '\x1f', ' ' }) {
+                std::string text(length, 'a');
+                text[position] = c;
+                if (position + 2 < length) {
+                    text[position + 2] = ' ';
+                }
+                check(text);
+            }
+        }
+    }
+
+    // Bytes above 0x7f are negative chars, but not control characters
+    std::mt19937 generator(15);
+    const std::string alphabet = std::string("  ab\x01\x1f\x7f") + '\0' + "\xc3\xa9";
+    std::uniform_int_distribution<size_t> letter_distribution(0, alphabet.size() - 1);
+    for (int i = 0; i < 2000; ++i) {
+        std::string text(std::uniform_int_distribution<size_t>(0, 200)(generator), 'a');
+        for (char& c : text) {
+            // Mostly valid text, so the first control character is not always near the start
+            if (std::uniform_int_distribution<int>(0, 15)(generator) == 0) {
+                c = alphabet[letter_distribution(generator)];
+            }
+            else if (std::uniform_int_distribution<int>(0, 3)(generator) == 0) {
+                c = ' ';
+            }
+        }
+        check(text);
+    }
+}
+
+void TestStopWordSet() {
+
+    assert(!StopWordSet().Contains("in"));
+    assert(!StopWordSet().Contains(""));
+
+    const std::string long_word(70, 'x');
+    const std::set<std::string, std::less<>> stop_words = { "a", "and", "in", "it", "of", "\xc3\xa9t\xc3\xa9", long_word };
+    const StopWordSet stop_word_set(stop_words);
+    assert(std::vector<std::string>(stop_words.begin(), stop_words.end()) == stop_word_set.GetWords());
+
+    // Same length or first character as a stop word, prefixes, and lengths past the length mask
+    for (const std::string& word : std::vector<std::string>{ "", "a", "b", "an", "and", "ant", "andx", "in", "is", "it", "i", "of", "off",
+        "\xc3\xa9t\xc3\xa9", "\xc3\xa9t\xc3", long_word, long_word + "x", std::string(70, 'y'), std::string(69, 'x') }) {
+        assert(stop_word_set.Contains(word) == (stop_words.count(word) > 0));
+    }
+
+    // Enough words for the table to grow and probe past collisions
+    std::set<std::string, std::less<>> many_words;
+    for (int i = 0; i < 3000; i += 2) {
+        many_words.insert("w" + std::to_string(i));
+    }
+    const StopWordSet many_word_set(many_words);
+    for (int i = 0; i < 3000; ++i) {
+        assert(many_word_set.Contains("w" + std::to_string(i)) == (i % 2 == 0));
+    }
+
+    // Stop words are skipped in documents and queries
+    SearchServer search_server(std::string("and in"));
+    search_server.AddDocument(1, "cat and dog", DocumentStatus::ACTUAL, { 1 });
+    assert(search_server.GetWordFrequencies(1).size() == 2);
+    assert(search_server.FindTopDocuments("and in").empty());
+    assert(search_server.FindTopDocuments("in dog").size() == 1);
+}
+
+void TestResultCache() {
+
+    SearchServer search_server(TEST_STOP_WORDS);
+    search_server.AddDocument(1, "cat dog", DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "cat", DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(3, "dog bird", DocumentStatus::BANNED, { 3 });
+    search_server.SetResultCacheCapacity(2);
+
+    const auto check_stats = [&](uint64_t hits, uint64_t misses, size_t entry_count) {
+        const QueryResultCache::Stats stats = search_server.GetResultCacheStats();
+        assert(stats.hits == hits && stats.misses == misses && stats.entry_count == entry_count);
+    };
+
+    const std::vector<Document> cat_dog = search_server.FindTopDocuments("cat dog");
+    check_stats(0, 1, 1);
+    AssertSameDocuments(search_server.FindTopDocuments("cat dog"), cat_dog, 0.0);
+    check_stats(1, 1, 1);
+    // Queries are normalized, so word order and repeated words share an entry
+    AssertSameDocuments(search_server.FindTopDocuments("dog cat cat"), cat_dog, 0.0);
+    check_stats(2, 1, 1);
+
+    // Other statuses and filters are other entries, custom predicates bypass the cache
+    assert(search_server.FindTopDocuments("cat dog", DocumentStatus::BANNED).size() == 1);
+    check_stats(2, 2, 2);
+    assert(search_server.FindTopDocuments("cat dog", [](int, DocumentStatus, int) { return true; }).size() == 3);
+    check_stats(2, 2, 2);
+
+    // The least recently used entry goes first
+    search_server.FindTopDocuments(std::execution::seq, "cat dog", DocumentFilter{ DocumentStatus::ACTUAL, 2, 5 }, 5);
+    check_stats(2, 3, 2);
+    search_server.FindTopDocuments("cat dog");
+    check_stats(2, 4, 2);
+
+    // Any change of the index makes the entries stale
+    search_server.AddDocument(4, "dog dog", DocumentStatus::ACTUAL, { 4 });
+    const std::vector<Document> with_added = search_server.FindTopDocuments("cat dog");
+    check_stats(2, 5, 2);
+    assert(with_added.size() == 3);
+    search_server.RemoveDocument(4);
+    AssertSameDocuments(search_server.FindTopDocuments("cat dog"), cat_dog, 0.0);
+    check_stats(2, 6, 2);
+
+    search_server.SetResultCacheCapacity(0);
+    search_server.FindTopDocuments("cat dog");
+    check_stats(0, 0, 0);
+
+    // A cached server answers like an uncached one while the index changes
+    std::mt19937 generator(16);
+    std::map<int, TestDocument> documents = GenerateTestCorpus(generator, 300);
+    const std::vector<std::string> queries = GenerateTestQueries(generator, 40);
+    SearchServer cached_server = BuildTestServer(documents);
+    cached_server.Freeze();
+    cached_server.SetResultCacheCapacity(256);
+    for (int round = 0; round < 4; ++round) {
+        AssertSameResults(BuildTestServer(documents), cached_server, queries, REFERENCE_TOLERANCE);
+        AssertSameResults(BuildTestServer(documents), cached_server, queries, REFERENCE_TOLERANCE);
+        for (int id = round; id < 300; id += 9) {
+            documents.erase(id);
+            cached_server.RemoveDocument(id);
+        }
+        const int id = 300 + round;
+        documents[id] = GenerateTestDocument(generator, id);
+        cached_server.AddDocument(id, documents[id].text, documents[id].status, documents[id].ratings);
+    }
+    assert(cached_server.GetResultCacheStats().hits > 0);
+}
+
+void TestMaxScoreMatchesExhaustive() {
+
+    // Several MaxScore windows and long queries, so non-essential terms are skipped often
+    std::mt19937 generator(17);
+    const std::map<int, TestDocument> documents = GenerateTestCorpus(generator, 5000);
+    std::vector<std::string> queries;
+    for (int i = 0; i < 80; ++i) {
+        queries.push_back(GenerateTestText(generator, 8));
+        if (i % 4 == 0) {
+            queries.back() += " -w" + std::to_string(std::uniform_int_distribution<int>(2, 20)(generator));
+        }
+    }
+
+    // Without a frozen index every posting is scored
+    const SearchServer exhaustive_server = BuildTestServer(documents);
+    const auto is_odd = [](int document_id, DocumentStatus, int) { return document_id % 2 == 1; };
+    for (const PostingFormat format : { PostingFormat::PLAIN, PostingFormat::COMPRESSED }) {
+        SearchServer max_score_server = BuildTestServer(documents);
+        max_score_server.Freeze(format);
+        AssertSameResults(exhaustive_server, max_score_server, queries, REFERENCE_TOLERANCE);
+
+        // Small top counts raise the threshold early
+        for (const std::string& query : queries) {
+            for (const size_t top_count : { 1, 2, 5, 50 }) {
+                for (const DocumentFilter& filter : { DocumentFilter{}, DocumentFilter{ DocumentStatus::BANNED },
+                    DocumentFilter{ DocumentStatus::ACTUAL, 0, 4 } }) {
+                    AssertSameDocuments(exhaustive_server.FindTopDocuments(std::execution::seq, query, filter, top_count),
+                        max_score_server.FindTopDocuments(std::execution::seq, query, filter, top_count), REFERENCE_TOLERANCE);
+                    AssertSameDocuments(exhaustive_server.FindTopDocuments(std::execution::par, query, filter, top_count),
+                        max_score_server.FindTopDocuments(std::execution::par, query, filter, top_count), REFERENCE_TOLERANCE);
+                }
+                AssertSameDocuments(exhaustive_server.FindTopDocuments(std::execution::seq, query, is_odd, top_count),
+                    max_score_server.FindTopDocuments(std::execution::seq, query, is_odd, top_count), REFERENCE_TOLERANCE);
+            }
+        }
+    }
+}
+
+void TestShardedMatchesSingleServer() {
+
+    std::mt19937 generator(18);
+    std::map<int, TestDocument> documents = GenerateTestCorpus(generator, 700);
+    const std::vector<std::string> queries = GenerateTestQueries(generator, 60);
+
+    // Every shard ranks with the document frequencies of the whole collection
+    const auto assert_same_results = [&](const ShardedSearchServer& sharded_server) {
+        const SearchServer search_server = BuildTestServer(documents);
+        assert(sharded_server.GetDocumentCount() == search_server.GetDocumentCount());
+        const auto is_even = [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; };
+        for (const std::string& query : queries) {
+            for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+                AssertSameDocuments(search_server.FindTopDocuments(std::execution::seq, query, status, 20),
+                    sharded_server.FindTopDocuments(std::execution::par, query, status, 20), REFERENCE_TOLERANCE);
+                AssertSameDocuments(search_server.FindTopDocuments(std::execution::seq, query, status, 3),
+                    sharded_server.FindTopDocuments(std::execution::seq, query, status, 3), REFERENCE_TOLERANCE);
+            }
+            AssertSameDocuments(search_server.FindTopDocuments(query, is_even),
+                sharded_server.FindTopDocuments(query, is_even), REFERENCE_TOLERANCE);
+        }
+        for (const int document_id : { 5, 6, 350, 699 }) {
+            if (documents.count(document_id) > 0) {
+                assert(search_server.MatchDocument(queries[0], document_id) == sharded_server.MatchDocument(queries[0], document_id));
+            }
+        }
+    };
+
+    for (const size_t shard_count : { 1, 3, 4 }) {
+        const std::map<int, TestDocument> initial_documents = documents;
+        ShardedSearchServer sharded_server(TEST_STOP_WORDS, shard_count);
+        assert(sharded_server.GetShardCount() == shard_count);
+        for (const auto& [id, document] : documents) {
+            sharded_server.AddDocument(id, document.text, document.status, document.ratings);
+        }
+        assert_same_results(sharded_server);
+
+        // Removals change the shared document frequencies seen by the other shards
+        sharded_server.Freeze();
+        for (int id = 0; id < 700; id += 11) {
+            documents.erase(id);
+            sharded_server.RemoveDocument(id);
+        }
+        for (int id = 700; id < 730; ++id) {
+            documents[id] = GenerateTestDocument(generator, id);
+            sharded_server.AddDocument(id, documents[id].text, documents[id].status, documents[id].ratings);
+        }
+        assert_same_results(sharded_server);
+
+        // Errors of a shard reach the caller
+        try {
+            sharded_server.FindTopDocuments("w5 --w6");
+            assert(false);
+        }
+        catch (const std::invalid_argument&) {
+        }
+        try {
+            sharded_server.AddDocument(701, "w5", DocumentStatus::ACTUAL, { 1 });
+            assert(false);
+        }
+        catch (const std::invalid_argument&) {
+        }
+        documents = initial_documents;
+    }
+}
+
+void TestConcurrentUpdates() {
+
+    std::mt19937 generator(19);
+    std::map<int, TestDocument> documents = GenerateTestCorpus(generator, 400);
+    const std::vector<std::string> queries = GenerateTestQueries(generator, 30);
+
+    {
+        ConcurrentSearchServer concurrent_server(TEST_STOP_WORDS);
+        for (int id = 0; id < 200; ++id) {
+            concurrent_server.AddDocument(id, documents[id].text, documents[id].status, documents[id].ratings);
+        }
+        concurrent_server.Freeze();
+
+        // Writers do not wait for a held snapshot, and the snapshot does not see their changes
+        std::shared_ptr<const SearchServer> snapshot = concurrent_server.GetSnapshot();
+        const std::vector<Document> pinned_results = snapshot->FindTopDocuments(queries[0]);
+        for (int id = 200; id < 400; ++id) {
+            concurrent_server.AddDocument(id, documents[id].text, documents[id].status, documents[id].ratings);
+            if (id % 50 == 0) {
+                concurrent_server.MergeDeltaSegment();
+            }
+        }
+        concurrent_server.RemoveDocument(0);
+        assert(snapshot->GetDocumentCount() == 200);
+        AssertSameDocuments(snapshot->FindTopDocuments(queries[0]), pinned_results, 0.0);
+        snapshot.reset();
+
+        // Retired instances catch up by replaying the changes they missed
+        documents.erase(0);
+        concurrent_server.RemoveDocument(1);
+        documents.erase(1);
+        concurrent_server.RemoveDocument(2);
+        documents.erase(2);
+        AssertSameResults(BuildTestServer(documents), *concurrent_server.GetSnapshot(), queries, REFERENCE_TOLERANCE);
+
+        // A failed change publishes nothing and is not replayed
+        try {
+            concurrent_server.AddDocument(3, "w5", DocumentStatus::ACTUAL, { 1 });
+            assert(false);
+        }
+        catch (const std::invalid_argument&) {
+        }
+        concurrent_server.RemoveDocument(3);
+        documents.erase(3);
+        AssertSameResults(BuildTestServer(documents), *concurrent_server.GetSnapshot(), queries, REFERENCE_TOLERANCE);
+    }
+
+    // Readers see every version whole: documents are added and removed in id order,
+    // so the ids of any version form one range
+    ConcurrentSearchServer concurrent_server(TEST_STOP_WORDS);
+    concurrent_server.Freeze();
+    concurrent_server.StartBackgroundMerging(20, std::chrono::milliseconds(1));
+    std::atomic<bool> is_writing = true;
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < 2; ++reader) {
+        readers.emplace_back([&, reader] {
+            while (is_writing) {
+                const std::shared_ptr<const SearchServer> snapshot = concurrent_server.GetSnapshot();
+                const std::vector<int> ids(snapshot->begin(), snapshot->end());
+                for (size_t i = 1; i < ids.size(); ++i) {
+                    assert(ids[i] == ids[i - 1] + 1);
+                }
+                assert(snapshot->GetDocumentCount() == static_cast<int>(ids.size()));
+                snapshot->FindTopDocuments(queries[reader]);
+                std::this_thread::yield();
+            }
+        });
+    }
+    for (int id = 0; id < 400; ++id) {
+        concurrent_server.AddDocument(id, documents.count(id) > 0 ? documents[id].text : "w5", DocumentStatus::ACTUAL, { 1 });
+        if (id % 3 == 0) {
+            concurrent_server.RemoveDocument(id / 3);
+        }
+    }
+    is_writing = false;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    concurrent_server.StopBackgroundMerging();
+    assert(concurrent_server.GetDocumentCount() == 400 - 134);
+    const std::vector<int> ids(concurrent_server.GetSnapshot()->begin(), concurrent_server.GetSnapshot()->end());
+    assert(ids.front() == 134 && ids.back() == 399);
+}
+
+void TestBatchQueryExecutor() {
+
+    std::mt19937 generator(21);
+    const std::map<int, TestDocument> documents = GenerateTestCorpus(generator, 3000);
+    std::vector<std::string> queries = GenerateTestQueries(generator, 150);
+    for (int i = 0; i < 30; ++i) {
+        queries.push_back(GenerateTestText(generator, 12) + " -w" + std::to_string(i + 2));
+    }
+
+    // More workers than this machine may have, and split queries from three words on
+    BatchQueryExecutor executor(4);
+    assert(executor.GetWorkerCount() == 4);
+    for (const bool is_frozen : { false, true }) {
+        SearchServer search_server = BuildTestServer(documents);
+        if (is_frozen) {
+            search_server.Freeze();
+        }
+        const std::vector<std::vector<Document>> expected_results = ProcessQueries(search_server, queries);
+        for (const size_t max_query_parallelism : { 1, 2, 4 }) {
+            executor.SetQuerySplitting(3, max_query_parallelism);
+            BatchQueryExecutor::BatchStats stats;
+            const std::vector<std::vector<Document>> results = executor.ProcessQueries(search_server, queries, &stats);
+            assert(results.size() == queries.size());
+            for (size_t i = 0; i < queries.size(); ++i) {
+                AssertSameDocuments(expected_results[i], results[i], REFERENCE_TOLERANCE);
+            }
+            assert(stats.query_count == queries.size());
+            assert(stats.median_latency <= stats.p99_latency && stats.p99_latency <= stats.max_latency);
+        }
+    }
+
+    // The whole batch runs, then the error of the earliest invalid query is thrown
+    const SearchServer search_server = BuildTestServer(documents);
+    std::vector<std::string> invalid_queries(40, "w2 w3 w4 w5");
+    invalid_queries[30] = "w2 w3 --late";
+    invalid_queries[7] = "w2 w3 --early";
+    for (const size_t max_query_parallelism : { 1, 4 }) {
+        executor.SetQuerySplitting(3, max_query_parallelism);
+        try {
+            executor.ProcessQueries(search_server, invalid_queries);
+            assert(false);
+        }
+        catch (const std::invalid_argument& error) {
+            assert(std::string(error.what()).find("--early") != std::string::npos);
+        }
+        // The executor is ready for the next batch
+        assert(executor.ProcessQueries(search_server, queries).size() == queries.size());
+    }
+}
+
+void TestJoinedAndStreamingResults() {
+
+    std::mt19937 generator(22);
+    SearchServer search_server = BuildTestServer(GenerateTestCorpus(generator, 500));
+    search_server.Freeze();
+    const std::vector<std::string> queries = GenerateTestQueries(generator, 80);
+    const std::vector<std::vector<Document>> expected_results = ProcessQueries(search_server, queries);
+
+    const JoinedQueryResults joined_results = ProcessQueriesJoined(search_server, queries);
+    assert(joined_results.offsets.size() == queries.size() + 1 && joined_results.offsets.front() == 0);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        AssertSameDocuments(expected_results[i], std::vector<Document>(joined_results.documents.begin() + joined_results.offsets[i],
+            joined_results.documents.begin() + joined_results.offsets[i + 1]), 0.0);
+    }
+    assert(joined_results.size() == joined_results.offsets.back());
+    assert(ProcessQueriesJoined(search_server, {}).size() == 0);
+
+    size_t next_query = 0;
+    ProcessQueriesStreaming(search_server, queries, [&](size_t i, const std::vector<Document>& documents) {
+        assert(i == next_query++);
+        AssertSameDocuments(expected_results[i], documents, 0.0);
+    });
+    assert(next_query == queries.size());
+
+    // Joined reports the first invalid query; streaming reports it in its turn
+    std::vector<std::string> invalid_queries = queries;
+    invalid_queries[60] = "w2 --late";
+    invalid_queries[20] = "w2 --early";
+    try {
+        ProcessQueriesJoined(search_server, invalid_queries);
+        assert(false);
+    }
+    catch (const std::invalid_argument& error) {
+        assert(std::string(error.what()).find("--early") != std::string::npos);
+    }
+    next_query = 0;
+    try {
+        ProcessQueriesStreaming(search_server, invalid_queries, [&](size_t i, const std::vector<Document>&) {
+            assert(i == next_query++);
+        });
+        assert(false);
+    }
+    catch (const std::invalid_argument& error) {
+        assert(std::string(error.what()).find("--early") != std::string::npos);
+    }
+    assert(next_query == 20);
+
+    // An error of the consumer stops the stream
+    next_query = 0;
+    try {
+        ProcessQueriesStreaming(search_server, queries, [&](size_t i, const std::vector<Document>&) {
+            ++next_query;
+            if (i == 10) {
+                throw std::runtime_error("Consumer failed");
+            }
+        });
+        assert(false);
+    }
+    catch (const std::runtime_error&) {
+    }
+    assert(next_query == 11);
+}
+
+void TestAsyncSearchServer() {
+
+    std::mt19937 generator(23);
+    SearchServer search_server = BuildTestServer(GenerateTestCorpus(generator, 500));
+    search_server.Freeze();
+    const std::vector<std::string> queries = GenerateTestQueries(generator, 60);
+
+    // Waits for the ticket and checks its result; returns the drop reason, if any
+    const auto check_ticket = [&](AsyncSearchServer::QueryTicket& ticket, const std::string& query,
+        DocumentStatus status) -> std::optional<QueryDroppedError::Reason> {
+        try {
+            AssertSameDocuments(search_server.FindTopDocuments(query, status), ticket.result.get(), 0.0);
+            return std::nullopt;
+        }
+        catch (const QueryDroppedError& error) {
+            return error.GetReason();
+        }
+    };
+
+    {
+        AsyncSearchServer async_server(search_server, { 2, 1024, AsyncSearchServer::OverloadPolicy::REJECT });
+        std::vector<AsyncSearchServer::QueryTicket> tickets;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            tickets.push_back(async_server.Submit(queries[i], i % 2 == 0 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED));
+        }
+        for (size_t i = 0; i < queries.size(); ++i) {
+            assert(!check_ticket(tickets[i], queries[i], i % 2 == 0 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED));
+        }
+
+        // Invalid queries fail through their future, expired ones are never run
+        AsyncSearchServer::QueryTicket invalid_ticket = async_server.Submit("w2 --w3");
+        try {
+            invalid_ticket.result.get();
+            assert(false);
+        }
+        catch (const std::invalid_argument&) {
+        }
+        AsyncSearchServer::QueryTicket expired_ticket = async_server.Submit(queries[0], DocumentStatus::ACTUAL,
+            AsyncSearchServer::Clock::now() - std::chrono::seconds(1));
+        assert(check_ticket(expired_ticket, queries[0], DocumentStatus::ACTUAL) == QueryDroppedError::Reason::DEADLINE_EXCEEDED);
+
+        const AsyncSearchServer::Stats stats = async_server.GetStats();
+        assert(stats.completed == queries.size() && stats.failed == 1 && stats.expired == 1);
+        assert(stats.rejected == 0 && stats.cancelled == 0);
+    }
+
+    // Which queries are rejected, cancelled or dropped at shutdown depends on timing,
+    // but every ticket gets its result or the reason it was dropped, and the counts agree
+    for (const auto overload_policy : { AsyncSearchServer::OverloadPolicy::REJECT, AsyncSearchServer::OverloadPolicy::WAIT }) {
+        std::vector<AsyncSearchServer::QueryTicket> tickets;
+        AsyncSearchServer::Stats stats;
+        {
+            AsyncSearchServer async_server(search_server, { 1, 2, overload_policy });
+            for (size_t i = 0; i < queries.size(); ++i) {
+                tickets.push_back(async_server.Submit(queries[i]));
+                if (i % 5 == 0) {
+                    tickets.back().Cancel();
+                }
+            }
+            stats = async_server.GetStats();
+        }
+        std::map<QueryDroppedError::Reason, uint64_t> drop_counts;
+        uint64_t completed_count = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const std::optional<QueryDroppedError::Reason> reason = check_ticket(tickets[i], queries[i], DocumentStatus::ACTUAL);
+            if (reason) {
+                assert(*reason != QueryDroppedError::Reason::CANCELLED || i % 5 == 0);
+                ++drop_counts[*reason];
+            }
+            else {
+                ++completed_count;
+            }
+        }
+        assert(completed_count >= stats.completed);
+        assert(drop_counts[QueryDroppedError::Reason::CANCELLED] >= stats.cancelled);
+        assert(drop_counts[QueryDroppedError::Reason::QUEUE_FULL] == stats.rejected);
+        assert(drop_counts[QueryDroppedError::Reason::DEADLINE_EXCEEDED] == 0);
+        if (overload_policy == AsyncSearchServer::OverloadPolicy::WAIT) {
+            assert(stats.rejected == 0);
+        }
+    }
+}
+
+void TestQueryProfiler() {
+
+    QueryProfiler::Reset();
+    for (const int microseconds : { 1, 2, 3, 100 }) {
+        QueryProfiler::Record(QueryStage::RANKING, std::chrono::microseconds(microseconds));
+    }
+    // Counts of threads that have exited stay in the snapshot
+    std::thread([] { QueryProfiler::Record(QueryStage::RANKING, std::chrono::microseconds(5)); }).join();
+    QueryProfiler::Snapshot snapshot = QueryProfiler::GetSnapshot();
+    const QueryProfiler::StageStats& ranking = snapshot[static_cast<int>(QueryStage::RANKING)];
+    assert(ranking.count == 5);
+    assert(ranking.p50 <= ranking.p99 && ranking.p99 <= ranking.p999 && ranking.p999 <= ranking.max);
+    assert(ranking.max >= std::chrono::microseconds(50));
+    assert(snapshot[static_cast<int>(QueryStage::PARSE)].count == 0);
+    QueryProfiler::Reset();
+    assert(QueryProfiler::GetSnapshot()[static_cast<int>(QueryStage::RANKING)].count == 0);
+
+#ifndef SEARCH_SERVER_NO_PROFILING
+    // Every sequential query passes each stage of its search path once
+    std::mt19937 generator(25);
+    SearchServer search_server = BuildTestServer(GenerateTestCorpus(generator, 300));
+    const std::vector<std::string> queries = GenerateTestQueries(generator, 40);
+    const auto run_queries = [&] {
+        QueryProfiler::Reset();
+        for (const std::string& query : queries) {
+            search_server.FindTopDocuments(std::execution::seq, query);
+        }
+        snapshot = QueryProfiler::GetSnapshot();
+    };
+    const auto get_count = [&](QueryStage stage) {
+        return snapshot[static_cast<int>(stage)].count;
+    };
+
+    run_queries();
+    for (const QueryStage stage : { QueryStage::PARSE, QueryStage::MINUS_FILTER, QueryStage::POSTINGS,
+        QueryStage::RANKING, QueryStage::RESULT_BUILD }) {
+        assert(get_count(stage) == queries.size());
+    }
+
+    // MaxScore over a frozen index interleaves minus words and ranking with the postings
+    search_server.Freeze();
+    run_queries();
+    assert(get_count(QueryStage::PARSE) == queries.size() && get_count(QueryStage::POSTINGS) == queries.size());
+    assert(get_count(QueryStage::MINUS_FILTER) == 0 && get_count(QueryStage::RANKING) == 0);
+    assert(get_count(QueryStage::RESULT_BUILD) == queries.size());
+    QueryProfiler::Reset();
+#endif
+}
+
+void TestCompressedIndexMatchesPlain() {
+
+    std::mt19937 generator(11);
+    std::map<int, TestDocument> documents = GenerateTestCorpus(generator, 1000);
+    const std::vector<std::string> queries = GenerateTestQueries(generator, 100);
+
+    SearchServer plain_server = BuildTestServer(documents);
+    plain_server.Freeze(PostingFormat::PLAIN);
+    SearchServer compressed_server = BuildTestServer(documents);
+    compressed_server.Freeze(PostingFormat::COMPRESSED);
+
+    // Term frequencies are stored exactly in both formats, so relevance is equal to the bit
+    AssertSameResults(plain_server, compressed_server, queries, 0.0);
+    for (const int document_id : { 0, 1, 500, 999 }) {
+        assert(plain_server.GetWordFrequencies(document_id) == compressed_server.GetWordFrequencies(document_id));
+    }
+
+    // A delta segment on top of a compressed main segment ranks like a fresh index
+    for (int id = 1000; id < 1100; ++id) {
+        documents[id] = GenerateTestDocument(generator, id);
+        compressed_server.AddDocument(id, documents[id].text, documents[id].status, documents[id].ratings);
+    }
+    for (int id = 0; id < 1100; id += 7) {
+        documents.erase(id);
+        compressed_server.RemoveDocument(id);
+    }
+    assert(compressed_server.GetDeltaSegmentSize() > 0);
+    AssertSameResults(BuildTestServer(documents), compressed_server, queries, REFERENCE_TOLERANCE);
+}
+
+void TestSnapshotRoundTrip() {
+
+    // A fresh file in the temporary directory, removed before the test returns
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_test.snapshot").string();
+    std::mt19937 generator(12);
+    std::map<int, TestDocument> documents = GenerateTestCorpus(generator, 600);
+    const std::vector<std::string> queries = GenerateTestQueries(generator, 60);
+
+    for (const PostingFormat format : { PostingFormat::PLAIN, PostingFormat::COMPRESSED }) {
+        std::map<int, TestDocument> live_documents = documents;
+        SearchServer search_server = BuildTestServer(live_documents);
+        search_server.Freeze(format);
+        // Removed main documents and new delta documents have to be written as well
+        for (int id = 0; id < 600; id += 5) {
+            live_documents.erase(id);
+            search_server.RemoveDocument(id);
+        }
+        for (int id = 600; id < 650; ++id) {
+            live_documents[id] = GenerateTestDocument(generator, id);
+            search_server.AddDocument(id, live_documents[id].text, live_documents[id].status, live_documents[id].ratings);
+        }
+
+        search_server.SaveSnapshot(path);
+        {
+            SearchServer loaded_server = SearchServer::LoadSnapshot(path);
+            assert(loaded_server.IsFrozen());
+            AssertSameResults(search_server, loaded_server, queries, REFERENCE_TOLERANCE);
+            for (const auto& [id, document] : live_documents) {
+                assert(loaded_server.GetWordFrequencies(id) == search_server.GetWordFrequencies(id));
+            }
+            assert(std::equal(loaded_server.begin(), loaded_server.end(), search_server.begin(), search_server.end()));
+
+            // Changes copy the loaded server out of the mapping
+            loaded_server.RemoveDocument(601);
+            live_documents.erase(601);
+            loaded_server.AddDocument(1000, "w5 w6 w7", DocumentStatus::ACTUAL, { 1 });
+            live_documents[1000] = { 1000, "w5 w6 w7", DocumentStatus::ACTUAL, { 1 } };
+            AssertSameResults(BuildTestServer(live_documents), loaded_server, queries, REFERENCE_TOLERANCE);
+        }
+        std::remove(path.c_str());
+    }
+}
+
+void TestDeltaSegmentVisibility() {
+
+    std::mt19937 generator(13);
+    const std::vector<std::string> queries = GenerateTestQueries(generator, 60);
+
+    for (const PostingFormat format : { PostingFormat::PLAIN, PostingFormat::COMPRESSED }) {
+        std::map<int, TestDocument> documents = GenerateTestCorpus(generator, 400);
+        SearchServer search_server = BuildTestServer(documents);
+        search_server.Freeze(format);
+        assert(search_server.GetDeltaSegmentSize() == 0);
+
+        // Removed main documents become tombstones, added ones go to the delta
+        for (int id = 400; id < 440; ++id) {
+            documents[id] = GenerateTestDocument(generator, id);
+            search_server.AddDocument(id, documents[id].text, documents[id].status, documents[id].ratings);
+        }
+        for (const int id : { 3, 50, 51, 399, 410, 439 }) {
+            documents.erase(id);
+            search_server.RemoveDocument(id);
+        }
+        // Documents removed from the delta keep their ordinals until the next merge
+        assert(search_server.GetDeltaSegmentSize() == 40 + 4);
+        AssertSameResults(BuildTestServer(documents), search_server, queries, REFERENCE_TOLERANCE);
+
+        // Changes made between prepare and commit stay visible after the commit
+        const SearchServer::SegmentMerge merge = search_server.PrepareSegmentMerge();
+        for (int id = 440; id < 450; ++id) {
+            documents[id] = GenerateTestDocument(generator, id);
+            search_server.AddDocument(id, documents[id].text, documents[id].status, documents[id].ratings);
+        }
+        for (const int id : { 4, 420, 445 }) {
+            documents.erase(id);
+            search_server.RemoveDocument(id);
+        }
+        AssertSameResults(BuildTestServer(documents), search_server, queries, REFERENCE_TOLERANCE);
+
+        assert(search_server.CommitSegmentMerge(merge));
+        assert(search_server.GetDeltaSegmentSize() == 10 + 2);
+        AssertSameResults(BuildTestServer(documents), search_server, queries, REFERENCE_TOLERANCE);
+
+        search_server.MergeDeltaSegment();
+        assert(search_server.GetDeltaSegmentSize() == 0);
+        AssertSameResults(BuildTestServer(documents), search_server, queries, REFERENCE_TOLERANCE);
+    }
+}
+
+void TestRequestQueueWindowStats() {
+
+    SearchServer search_server(TEST_STOP_WORDS);
+    for (int id = 0; id < 8; ++id) {
+        search_server.AddDocument(id, id < 3 ? "cat dog" : "dog", DocumentStatus::ACTUAL, { id });
+    }
+
+    RequestQueue request_queue(search_server);
+    assert(request_queue.GetNoResultRequests() == 0);
+    assert(request_queue.GetWindowStats().request_count == 0);
+
+    for (int i = 0; i < 10; ++i) {
+        request_queue.AddFindRequest("bird");
+    }
+    for (int i = 0; i < 4; ++i) {
+        request_queue.AddFindRequest("cat");
+    }
+    for (int i = 0; i < 6; ++i) {
+        request_queue.AddFindRequest("dog");
+    }
+
+    RequestQueue::WindowStats stats = request_queue.GetWindowStats();
+    assert(stats.request_count == 20);
+    assert(stats.no_result_requests == 10);
+    assert(request_queue.GetNoResultRequests() == 10);
+    assert(stats.result_count_histogram[0] == 10);
+    assert(stats.result_count_histogram[3] == 4);
+    // Requests with MAX_RESULT_COUNT_BUCKET results or more share the last bucket
+    assert(stats.result_count_histogram[RequestQueue::MAX_RESULT_COUNT_BUCKET] == 6);
+    assert(stats.median_latency <= stats.p99_latency && stats.p99_latency <= stats.max_latency);
+
+    // Only the last 1440 requests are kept, so the first five leave the window
+    for (int i = 0; i < 1440 - 15; ++i) {
+        request_queue.AddFindRequest("cat");
+    }
+    stats = request_queue.GetWindowStats();
+    assert(stats.request_count == 1440);
+    assert(stats.no_result_requests == 5);
+    assert(request_queue.GetNoResultRequests() == 5);
+    assert(stats.result_count_histogram[3] == 4 + 1440 - 15);
+    assert(stats.result_count_histogram[RequestQueue::MAX_RESULT_COUNT_BUCKET] == 6);
+}
+
+void TestRejectedDocumentBatch() {
+
+    std::mt19937 generator(14);
+    const std::map<int, TestDocument> documents = GenerateTestCorpus(generator, 200);
+    const std::vector<std::string> queries = GenerateTestQueries(generator, 30);
+    SearchServer search_server = BuildTestServer(documents);
+    search_server.Freeze();
+
+    std::vector<SearchServer::NewDocument> batch(3);
+    batch[0] = { 300, "w5 w6", DocumentStatus::ACTUAL, { 1 } };
+    batch[1] = { 301, "w7 bad\x01word", DocumentStatus::ACTUAL, { 1 } };
+    batch[2] = { 302, "w8", DocumentStatus::ACTUAL, { 1 } };
+    for (const bool is_parallel : { false, true }) {
+        try {
+            if (is_parallel) {
+                search_server.AddDocuments(std::execution::par, batch);
+            }
+            else {
+                search_server.AddDocuments(batch);
+            }
+            assert(false);
+        }
+        catch (const std::invalid_argument&) {
+        }
+        AssertSameResults(BuildTestServer(documents), search_server, queries, REFERENCE_TOLERANCE);
+    }
+}
+
+void TestSearchServer() {
+    TestTokenizeWords();
+    TestStopWordSet();
+    TestResultCache();
+    TestMaxScoreMatchesExhaustive();
+    TestShardedMatchesSingleServer();
+    TestConcurrentUpdates();
+    TestBatchQueryExecutor();
+    TestJoinedAndStreamingResults();
+    TestAsyncSearchServer();
+    TestQueryProfiler();
+    TestCompressedIndexMatchesPlain();
+    TestSnapshotRoundTrip();
+    TestDeltaSegmentVisibility();
+    TestRequestQueueWindowStats();
+    TestRejectedDocumentBatch();
+    std::cerr << "Search server tests passed" << std::endl;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// Checks built on assert; every test builds its own servers and throws nothing on success
+
+// The SIMD tokenizer splits like a byte-by-byte loop and finds the same first
+// word with a control character, also at block boundaries
+void TestTokenizeWords();
+
+// Stop word lookups agree with std::set, also for words that pass the prefilter
+void TestStopWordSet();
+
+// Repeated filter queries hit the result cache until the index changes
+void TestResultCache();
+
+// MaxScore over a frozen index keeps the same top documents as scoring every posting
+void TestMaxScoreMatchesExhaustive();
+
+// A sharded server returns what one server with all documents returns, before and after changes
+void TestShardedMatchesSingleServer();
+
+// Snapshots of a ConcurrentSearchServer stay whole and unchanged while writers go on
+void TestConcurrentUpdates();
+
+// The executor returns ProcessQueries results whether or not long queries are split
+void TestBatchQueryExecutor();
+
+// Joined and streamed results equal those of ProcessQueries, errors come in query order
+void TestJoinedAndStreamingResults();
+
+// Futures of AsyncSearchServer carry the results, query errors and drop reasons
+void TestAsyncSearchServer();
+
+// Stage counts of the query profiler follow the search path of each query
+void TestQueryProfiler();
+
+// Both posting formats give the same results for the same corpus
+void TestCompressedIndexMatchesPlain();
+
+// A server loaded from a snapshot answers like the one that wrote it
+void TestSnapshotRoundTrip();
+
+// Documents added or removed on top of a frozen index are seen by queries right away,
+// also across PrepareSegmentMerge and CommitSegmentMerge
+void TestDeltaSegmentVisibility();
+
+// Request counts, empty results and the result count histogram of the RequestQueue window
+void TestRequestQueueWindowStats();
+
+// A batch with an invalid document adds nothing to a frozen server
+void TestRejectedDocumentBatch();
+
+void TestSearchServer();
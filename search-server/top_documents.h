@@ -0,0 +1,78 @@
+#pragma once
+#include "document.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+const double EPSILON = 1e-6;
+
+// Ranking order of search results: higher relevance first, ratings break ties within EPSILON
+// and the smaller id goes first among equal ratings, so the order never depends on the algorithm
+inline bool IsRankedHigher(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) >= EPSILON) {
+        return lhs.relevance > rhs.relevance;
+    }
+    return lhs.rating != rhs.rating
+        ? lhs.rating > rhs.rating
+        : lhs.id < rhs.id;
+}
+
+// Keeps the best `capacity` documents seen so far in a min-heap whose top is
+// the weakest kept document, so each push costs O(log capacity).
+// The storage is kept between Reset calls, so a reused heap stops allocating
+class TopDocumentsHeap {
+public:
+    TopDocumentsHeap() = default;
+
+    explicit TopDocumentsHeap(size_t capacity)
+        : capacity_(capacity)
+    {
+    }
+
+    void Reset(size_t capacity) {
+        capacity_ = capacity;
+        documents_.clear();
+    }
+
+    void Push(const Document& document) {
+        if (capacity_ == 0) {
+            return;
+        }
+        if (documents_.size() < capacity_) {
+            documents_.push_back(document);
+            std::push_heap(documents_.begin(), documents_.end(), IsRankedHigher);
+            return;
+        }
+        if (IsRankedHigher(document, documents_.front())) {
+            std::pop_heap(documents_.begin(), documents_.end(), IsRankedHigher);
+            documents_.back() = document;
+            std::push_heap(documents_.begin(), documents_.end(), IsRankedHigher);
+        }
+    }
+
+    bool IsFull() const {
+        return capacity_ > 0 && documents_.size() == capacity_;
+    }
+
+    // The document a new one has to outrank to be kept
+    const Document& GetWeakest() const {
+        return documents_.front();
+    }
+
+    void Merge(const TopDocumentsHeap& other) {
+        for (const Document& document : other.documents_) {
+            Push(document);
+        }
+    }
+
+    // Writes kept documents to result in ranking order and leaves the heap empty
+    void ExtractTo(std::vector<Document>& result) {
+        std::sort_heap(documents_.begin(), documents_.end(), IsRankedHigher);
+        result.assign(documents_.begin(), documents_.end());
+        documents_.clear();
+    }
+
+private:
+    size_t capacity_ = 0;
+    std::vector<Document> documents_;
+};